@@ -10,20 +10,114 @@
 
 
 
+// state of the asynchronous conversion
+#define TS_CONV_IDLE    0
+#define TS_CONV_RUN     1
+#define TS_CONV_EXPIRED 2
+
+static DS18B20*         tsConvSensor;
+static tsConvCallback   tsConvDone;
+static char             tsConvMode;
+static volatile char    tsConvState = TS_CONV_IDLE;
+
+static char             tsReadProfile = TS_PROFILE_FULL;
+
+static char             tsPipeRun = 0;          // set while the conversion started by the single sensor pipeline runs
+
+static char             tsPower   = TS_POWER_UNKNOWN;
+char                    tsSpuMask = 0;          // TS_SPU_BIT once a parasite powered sensor was found, also used by ts_script.s
+volatile char           tsOverrun = 0;          // set by ts_write.s when an interrupt stretched a slot into a reset
+
+
+/* transaction scripts run by tsRunScript, TS_OP_ROM addresses a single sensor
+   or every sensor on the bus depending on the addr passed to tsRunScript        */
+static const char tsScrConvert[]    = {TS_OP_RESET, TS_OP_ROM, TS_OP_CMD, CONVERT_T, TS_OP_STRONG, TS_OP_END};
+static const char tsScrCopy[]       = {TS_OP_RESET, TS_OP_ROM, TS_OP_CMD, COPY_SPAD, TS_OP_STRONG, TS_OP_END};
+static const char tsScrWrite[]      = {TS_OP_RESET, TS_OP_ROM, TS_OP_CMD, WRITE_SPAD, TS_OP_WRITE, 3, TS_OP_END};
+static const char tsScrWaitCopy[]   = {TS_OP_WAIT, TS_WAIT_BLOCKS(TS_COPY_US), TS_OP_END};
+static const char tsScrGetAddr[]    = {TS_OP_RESET, TS_OP_CMD, READ_ROM, TS_OP_LOAD_ADDR, TS_OP_END};
+static const char tsScrPower[]      = {TS_OP_RESET, TS_OP_CMD, SKIP_ROM, TS_OP_CMD, READ_PSUPPLY, TS_OP_END};
+
+// scratch pad reads, one per read profile
+static const char tsScrRead[]       = {TS_OP_RESET, TS_OP_ROM, TS_OP_CMD, READ_SPAD, TS_OP_READ, 9, TS_OP_END};
+static const char tsScrReadTemp[]   = {TS_OP_RESET, TS_OP_ROM, TS_OP_CMD, READ_SPAD, TS_OP_READ, 2, TS_OP_ABORT, TS_OP_END};
+static const char tsScrReadCrc[]    = {TS_OP_RESET, TS_OP_ROM, TS_OP_CMD, READ_SPAD, TS_OP_READ_CRC, 9, TS_OP_END};
+
+// scratch pad reads of tsReadTemp_sS, which also reads the ROM code
+static const char tsScrRomRead[]    = {TS_OP_RESET, TS_OP_CMD, READ_ROM, TS_OP_LOAD_ADDR, TS_OP_CMD, READ_SPAD, TS_OP_READ, 9, TS_OP_END};
+static const char tsScrRomReadTemp[]= {TS_OP_RESET, TS_OP_CMD, READ_ROM, TS_OP_LOAD_ADDR, TS_OP_CMD, READ_SPAD, TS_OP_READ, 2, TS_OP_ABORT, TS_OP_END};
+static const char tsScrRomReadCrc[] = {TS_OP_RESET, TS_OP_CMD, READ_ROM, TS_OP_LOAD_ADDR, TS_OP_CMD, READ_SPAD, TS_OP_READ_CRC, 9, TS_OP_END};
+
+
+
+
+static int tsReadScratch(DS18B20* sensor, char* addr, char profile)
+{
+    int status;
+
+/*  the temperature profile aborts the transfer after the temperature bytes,
+    and the verified profile calculates the CRC while the bytes are read      */
+
+    if(profile == TS_PROFILE_TEMP)
+        status = tsRunScript(tsScrReadTemp, addr, sensor->scrPad);
+    else if(profile == TS_PROFILE_VERIFIED)
+        status = tsRunScript(tsScrReadCrc, addr, sensor->scrPad);
+    else
+        status = tsRunScript(tsScrRead, addr, sensor->scrPad);
+
+    if(status == TS_OK)
+        sensor->temp = tsSPadTemp(sensor->scrPad);
+
+    return status;
+}
+
+int tsAddrValid(char* addr)
+{
+    // an all 0 ROM code passes the CRC, the family code rejects it
+    return addr[0] == TS_FAMILY_CODE && !tsCalcCrc(addr, 8);
+}
+
+static void tsCheckPower()
+{
+    // the power supply is only asked the first time, or until a sensor answers
+    if(tsPower == TS_POWER_UNKNOWN)
+        tsReadPower();
+}
+
+static void tsDelayMs(unsigned int ms)
+{
+    while(ms--)
+        __delay_cycles(TS_CYCLES(1000));
+}
+
+static unsigned long tsConvUs(char config)
+{
+    // tsConvTicks doubles for each extra bit and rejects an invalid configuration
+    return (unsigned long)TS_CONV_US * (tsConvTicks(config) / TS_CONV_TICKS);
+}
+
+
+
 
 // most of these functions follow the flow chart given in the datasheet
 
 
 
+#if TS_BACKEND == TS_BACKEND_ASM
+
 void tsInit()
 {
     TS_BUS_H;                       // release the bus
+    TS_SPU_OFF;
 	
     // initialize the gpio
     TS_INIT_INPORT  &= ~TS_INBIT;
     TS_INIT_OUTPORT |=  TS_OUTBIT;
+    TS_SPU_DIR      |=  TS_SPU_BIT;
 }
 
+#endif
+
 
 
 
@@ -42,21 +136,34 @@ int tsWrite(char byte)
 
 
 
+#if TS_BACKEND == TS_BACKEND_ASM
+
 int tsMstRst()
 {
-    // initital reset pulse
+    unsigned int gie = __get_SR_register() & GIE;
+    int presence;
+
+    // initital reset pulse, an interrupt can only make it longer
      TS_BUS_L;
     __delay_cycles(TS_RST_DELAY);
+
+    // the presence pulse must be sampled within 75us of the release
+    __disable_interrupt();
+
     TS_BUS_H;
     __delay_cycles(TS_60us);
 
+    presence = TS_BUS_IS_LOW;
+
+    __bis_SR_register(gie);
+
 /*	if the sensor sends a feedback acknowledging the
 	initial reset pulse, wait a bit and return
 	that the function was a success, otherwise
 	return that there was no feedback from the
 	sensor	 */
 
-    if(TS_BUS_IS_LOW)
+    if(presence)
     {
         __delay_cycles(TS_RST_DELAY);
         return 0;
@@ -64,6 +171,91 @@ int tsMstRst()
     else return -1;
 }
 
+#else
+
+int tsRunScript(const char* script, char* addr, char* buf)
+{
+    // the assembly backend runs the scripts in ts_script.s, the other backends use the same interpreter in C
+    int n, slots;
+
+    for(;;)
+    {
+        switch(*script++)
+        {
+        case TS_OP_RESET:
+            if(tsMstRst())
+                return TS_ERR_PRESENCE;
+            break;
+
+        case TS_OP_ABORT:
+            tsMstRst();
+            break;
+
+        case TS_OP_CMD:
+            // a strong pull-up right after the command is turned on by the byte writer itself
+            if(script[1] == TS_OP_STRONG)
+            {
+                tsWriteByteStrong(script[0], tsSpuMask);
+                script += 2;
+            }
+            else tsWriteByte(*script++);
+            break;
+
+        case TS_OP_ROM:
+            if(addr)
+                tsMatchAddr(addr);
+            else
+                tsWriteByte(SKIP_ROM);
+            break;
+
+        case TS_OP_WRITE:
+            for(n = *script++; n > 0; n--)
+                tsWriteByte(*buf++);
+            break;
+
+        case TS_OP_READ:
+            n = *script++;
+            tsReadData(buf, n);
+            buf += n;
+            break;
+
+        case TS_OP_READ_CRC:
+            n = *script++;
+            if(tsReadDataCrc(buf, n))
+                return TS_ERR_CRC;
+            buf += n;
+            break;
+
+        case TS_OP_WAIT:
+            // n blocks of read slots, a 1 ends the wait before the deadline
+            for(n = (unsigned char)*script++; n > 0; n--)
+            {
+                for(slots = TS_WAIT_BLOCK; slots > 0 && !tsReadBit(); slots--);
+
+                if(slots)
+                    break;
+            }
+
+            if(!n)
+                return TS_ERR_TIMEOUT;
+            break;
+
+        case TS_OP_STRONG:
+            TS_SPU_OUT |= tsSpuMask;
+            break;
+
+        case TS_OP_LOAD_ADDR:
+            tsReadData(addr, 8);
+            break;
+
+        default:
+            return TS_OK;
+        }
+    }
+}
+
+#endif
+
 
 
 
@@ -79,36 +271,197 @@ int tsGetAddr(DS18B20* sensor)
     bus with a single wire. I recommend using this function one sensor
     at a time to get the address instead of using the search sensor function   */
 
-    // if the reset pulse sends a feedback
-    if(!tsMstRst())
+    // send a read rom command and proceed to read 8 bytes if the reset pulse sends a feedback
+    return tsRunScript(tsScrGetAddr, sensor->addr, 0);
+
+}
+
+
+
+
+
+
+
+void tsSearchInit(DS18B20Search* search)
+{
+    search->command         = SEARCH_ROM;
+    search->lastDiscrepancy = 0;
+    search->lastDevice      = 0;
+}
+
+int tsSearchNext(DS18B20Search* search)
+{
+    char addr[8];
+    char mask;
+    int  idBit, cmpBit, dir;
+    int  lastZero = 0;
+    int  i;
+
+    // every device was already found in a previous pass
+    if(search->lastDevice)
+        return -1;
+
+    if(tsMstRst())
+        return -1;
+
+    tsOverrun = 0;
+
+    tsWriteByte(search->command);
+
+/*  walk the 64 bits of the ROM codes. Every device answers with its bit and
+    then with its complement, so a 0 followed by a 1 (or vice versa) means all
+    devices still in the search agree on that bit, and two 0s mean there is a
+    branch in the tree. The path taken is written back so the devices that
+    don't match it drop out of the search                                       */
+
+    for(i = 0; i < 64; i++)
     {
-	// send a read rom command and proceed to read 8 bits
-        tsWriteByte(READ_ROM);
-        tsReadData(sensor->addr, 8);
+        mask   = 1 << (i & 7);
 
-        return 0;
+        idBit  = tsReadBit();
+        cmpBit = tsReadBit();
+
+        // no device is participating in the search anymore, or an interrupt reset all of them
+        if(idBit && cmpBit)
+            return tsOverrun ? TS_ERR_OVERRUN : -1;
+
+        if(idBit != cmpBit)
+            dir = idBit;
+        else
+        {
+            // before the last branch follow the same path as the previous pass,
+            // take the 1 path at the last branch and the 0 path after it
+            if(i + 1 < search->lastDiscrepancy)
+                dir = (search->addr[i >> 3] & mask) != 0;
+            else
+                dir = (i + 1 == search->lastDiscrepancy);
+
+            if(!dir)
+                lastZero = i + 1;
+        }
+
+        if(dir)
+            addr[i >> 3] |=  mask;
+        else
+            addr[i >> 3] &= ~mask;
+
+        tsWriteBit(dir);
+    }
+
+    // reject the ROM code without moving the search forward if the CRC fails
+    if(tsOverrun)
+        return TS_ERR_OVERRUN;
+
+    if(tsCalcCrc(addr, 8))
+        return TS_ERR_CRC;
+
+    // a shorted bus reads an all 0 ROM code, whose CRC is also 0
+    for(i = 0; i < 8 && !addr[i]; i++);
+
+    if(i == 8)
+        return -1;
+
+    for(i = 0; i < 8; i++)
+        search->addr[i] = addr[i];
+
+    search->lastDiscrepancy = lastZero;
+
+    if(!lastZero)
+        search->lastDevice = 1;
+
+    // another kind of device is skipped, the search goes on with the devices after it
+    if(addr[0] != TS_FAMILY_CODE)
+        return tsSearchNext(search);
+
+    return 0;
+}
+
+int tsSearchNextRetry(DS18B20Search* search)
+{
+    int result;
+    int retry = 0;
+
+    // search the same device again if the ROM code was corrupted
+    do
+        result = tsSearchNext(search);
+    while((result == TS_ERR_CRC || result == TS_ERR_OVERRUN) && ++retry < TS_SEARCH_RETRY);
+
+    return result;
+}
+
+static int tsSearchAll(DS18B20Search* search, DS18B20* sensors, int maxSensors)
+{
+    int found = 0;
+    int i;
+
+    while(found < maxSensors)
+    {
+        if(tsSearchNextRetry(search))
+            break;
+
+        for(i = 0; i < 8; i++)
+            sensors[found].addr[i] = search->addr[i];
+
+        found++;
     }
-    // otherwise send an error
-    else return -1;
 
+    return found;
 }
 
+int tsSearchRom(DS18B20* sensors, int maxSensors)
+{
+    DS18B20Search search;
+
+    tsSearchInit(&search);
+
+    return tsSearchAll(&search, sensors, maxSensors);
+}
+
+void tsAlarmSearchInit(DS18B20Search* search)
+{
+    tsSearchInit(search);
+    search->command = ALARM_SEARCH;
+}
+
+int tsAlarmScan(DS18B20* alarms, int maxAlarms)
+{
+    DS18B20Search search;
+    int found, i;
 
+    // convert the temperature of every sensor at once, the alarm flags are updated after the conversion
+    if(tsConvertTemp())
+        return -1;
 
+    // the resolution of the sensors isn't known yet
+    if(tsWaitConvert(TS_12BITS))
+        return -1;
 
+    // only the sensors outside of their thresholds answer the alarm search
+    tsAlarmSearchInit(&search);
+    found = tsSearchAll(&search, alarms, maxAlarms);
+
+    for(i = 0; i < found; i++)
+        alarms[i].status = tsReadSPad(&alarms[i]);
+
+    return found;
+}
 
 
 
-void tsMatchAddr(DS18B20 sensor)
+
+
+
+
+void tsMatchAddr(char* addr)
 {
-    volatile int i;
+    int i;
 
     // send a match rom command
     tsWriteByte(MATCH_ROM);
 
     // send the address of the sensors to be used
     for(i = 0; i < 8 ; i++)
-        tsWriteByte(sensor.addr[i]);
+        tsWriteByte(addr[i]);
 }
 
 
@@ -117,20 +470,60 @@ void tsMatchAddr(DS18B20 sensor)
 
 
 
-void tsConvertTemp()
+int tsConvertTemp()
 {
 
 
 // This function can be used to address all sensors and command them to convert temperature
 
+    tsCheckPower();
 
-    if(!tsMstRst())
+    // send a skip rom command and convert the temperature of all sensors
+    return tsRunScript(tsScrConvert, 0, 0);
+
+}
+
+int tsReadPower()
+{
+    if(tsRunScript(tsScrPower, 0, 0))
+        return -1;
+
+    // parasite powered sensors pull the bus low during the read slot
+    tsPower   = tsReadBit() ? TS_POWER_EXTERNAL : TS_POWER_PARASITE;
+    tsSpuMask = (tsPower == TS_POWER_PARASITE) ? TS_SPU_BIT : 0;
+
+    return tsPower;
+}
+
+int tsWaitConvert(char config)
+{
+    char script[] = {TS_OP_WAIT, 0, TS_OP_END};
+
+    if(tsSpuMask)
     {
-	// send a skip rom command and convert the temperature of all sensors
-        tsWriteByte(SKIP_ROM);
-        tsWriteByte(CONVERT_T);
+        // the conversion time is rounded up to the next ms
+        tsDelayMs(((unsigned long)tsConvTicks(config) * 1000 + 32767) >> 15);
+        TS_SPU_OFF;
+
+        return TS_OK;
     }
 
+    // wait for temperature conversion, at most until the deadline of the resolution
+    script[1] = TS_WAIT_BLOCKS(tsConvUs(config));
+
+    return tsRunScript(script, 0, 0);
+}
+
+int tsWaitCopy()
+{
+    if(tsSpuMask)
+    {
+        tsDelayMs(TS_COPY_MS);
+        TS_SPU_OFF;
+
+        return TS_OK;
+    }
+    else return tsRunScript(tsScrWaitCopy, 0, 0);
 }
 
 
@@ -138,33 +531,49 @@ void tsConvertTemp()
 
 
 
-int tsValidateData(DS18B20 sensor)
+int tsValidateData(DS18B20* sensor)
 {
-    char shiftRegister = 0;
-    char input;
-    int  i, j;
+    return (tsCalcCrc(sensor->scrPad, 9) == 0 ? 0 : -1);
+}
 
-    for(i = 0; i < 9; i++)
-    {
-        for(j = 0; j < 8; j++)
-        {
-            input = (sensor.scrPad[i]>>j) ^ shiftRegister;
-            if(input&BIT0)
-            {
-                shiftRegister >>= 1;
-                shiftRegister  |= BIT7;
-                shiftRegister  ^= BIT2|BIT3;
 
-            }
-            else
-            {
-                shiftRegister >>= 1;
-            }
+// CRC of the low and the high nibble of (CRC ^ data), the CRC of a byte is the xor of both
+static const unsigned char tsCrcLo[16] = {0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83,
+                                          0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41};
+static const unsigned char tsCrcHi[16] = {0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8,
+                                          0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74};
 
-        }
+int tsSPadTemp(const char* scrPad)
+{
+    // the bytes are cast so the lsb doesn't sign extend over the msb
+    return ((unsigned char)scrPad[TS_TEMP_MSB] << 8) | (unsigned char)scrPad[TS_TEMP_LSB];
+}
+
+void tsSerialAddr(char* addr, const char* serial)
+{
+    int i;
+
+    // the family code and the CRC are rebuilt around the serial
+    addr[0] = TS_FAMILY_CODE;
+
+    for(i = 0; i < 6; i++)
+        addr[i + 1] = serial[i];
+
+    addr[7] = tsCalcCrc(addr, 7);
+}
+
+char tsCalcCrc(char* data, int bufLen)
+{
+    unsigned char crc = 0;
+    int  i;
+
+    for(i = 0; i < bufLen; i++)
+    {
+        crc ^= data[i];
+        crc  = tsCrcLo[crc & 0x0F] ^ tsCrcHi[crc >> 4];
     }
 
-    return (shiftRegister == 0 ? 0 : -1);
+    return crc;
 }
 
 
@@ -175,110 +584,243 @@ int tsValidateData(DS18B20 sensor)
 
 int tsReadTemp(DS18B20* sensor)
 {
+    tsCheckPower();
+
     // first, convert the temperature
-    if(!tsMstRst())
+    if(!tsRunScript(tsScrConvert, sensor->addr, 0))
     {
-        tsMatchAddr(*sensor);
+        if(tsWaitConvert(sensor->scrPad[TS_CONFIG]))
+            return TS_ERR_TIMEOUT;
 
-        tsWriteByte(CONVERT_T);
+        // then read the scratch pad
+        return tsReadScratch(sensor, sensor->addr, tsReadProfile);
+    }
+    else return -1;
+}
 
-        while(!tsReadBit());        // wait for temperature conversion
+int tsReadTemp_sS(DS18B20* sensor)
+{
+    int status;
 
-        // then read the scratch pad
-        if(!tsMstRst())
-        {
-            tsMatchAddr(*sensor);
+    tsCheckPower();
 
-            tsWriteByte(READ_SPAD);
-            tsReadData(sensor->scrPad, 9);
+    if(!tsRunScript(tsScrConvert, 0, 0))
+    {
+        if(tsWaitConvert(sensor->scrPad[TS_CONFIG]))
+            return TS_ERR_TIMEOUT;
 
-            sensor->temp  = 0;
+        // once a valid ROM code was learned, SKIP_ROM addresses the only sensor on the bus
+        if(tsAddrValid(sensor->addr))
+            return tsReadScratch(sensor, 0, tsReadProfile);
 
-            sensor->temp |= sensor->scrPad[0];
-            sensor->temp |= sensor->scrPad[1]<<8;
+        // otherwise the ROM code is read into sensor->addr before the scratch pad
+        if(tsReadProfile == TS_PROFILE_TEMP)
+            status = tsRunScript(tsScrRomReadTemp, sensor->addr, sensor->scrPad);
+        else if(tsReadProfile == TS_PROFILE_VERIFIED)
+            status = tsRunScript(tsScrRomReadCrc, sensor->addr, sensor->scrPad);
+        else
+            status = tsRunScript(tsScrRomRead, sensor->addr, sensor->scrPad);
 
-            return 0;
-        }
-        else return -1;
+        if(status == TS_OK)
+            sensor->temp = tsSPadTemp(sensor->scrPad);
+
+        return status;
     }
     else return -1;
+
 }
 
-int tsReadTemp_sS(DS18B20* sensor)
+int tsPipeStart_sS(DS18B20* sensor)
 {
+    int status = TS_ERR_CRC;
+    int retry;
 
-    if(!tsMstRst())
+    // the ROM code is only learned once, and read again if it fails the CRC
+    for(retry = 0; retry < TS_SEARCH_RETRY && status == TS_ERR_CRC; retry++)
     {
-        tsWriteByte(SKIP_ROM);
+        status = tsGetAddr(sensor);
 
-        tsWriteByte(CONVERT_T);
-        while(!tsReadBit());        // wait for temperature conversion
+        if(status == TS_OK && !tsAddrValid(sensor->addr))
+            status = TS_ERR_CRC;
+    }
 
-        if(!tsMstRst())
-        {
+    if(status)
+        return status;
 
-            tsWriteByte(READ_ROM);
-            tsReadData(sensor->addr, 8);
+    // the resolution sets the deadline of every conversion
+    status = tsReadScratch(sensor, 0, TS_PROFILE_VERIFIED);
 
-            tsWriteByte(READ_SPAD);
-            tsReadData(sensor->scrPad, 9);
+    if(status)
+        return status;
 
-            sensor->temp  = 0;
+    tsCheckPower();
 
-            sensor->temp |= sensor->scrPad[0];
-            sensor->temp |= sensor->scrPad[1]<<8;
+    if(tsRunScript(tsScrConvert, 0, 0))
+        return TS_ERR_PRESENCE;
 
-            return 0;
-        }
-        else return -1;
-    }
-    else return -1;
+    tsPipeRun = 1;
 
+    return TS_OK;
 }
 
+int tsPipeNext_sS(DS18B20* sensor)
+{
+    int status;
+
+    if(!tsPipeRun)
+    {
+        status = tsPipeStart_sS(sensor);
 
+        if(status)
+            return status;
+    }
 
+    tsPipeRun = 0;
 
+    // only the part of the conversion that the caller didn't spend is left
+    if(tsWaitConvert(sensor->scrPad[TS_CONFIG]))
+        return TS_ERR_TIMEOUT;
 
+    status = tsReadScratch(sensor, 0, tsReadProfile);
 
+    // the next conversion runs while the caller works on this one
+    if(!tsRunScript(tsScrConvert, 0, 0))
+        tsPipeRun = 1;
 
-int tsReadSPad(DS18B20* sensor)
+    return status;
+}
+
+int tsPipeStop_sS(DS18B20* sensor)
 {
-    if(!tsMstRst())
-    {
-        tsMatchAddr(*sensor);
+    if(!tsPipeRun)
+        return TS_OK;
 
-        tsWriteByte(READ_SPAD);
-        tsReadData(sensor->scrPad, 9);
+    tsPipeRun = 0;
+
+    // the strong pull-up of a parasite powered bus is released by the wait
+    return tsWaitConvert(sensor->scrPad[TS_CONFIG]);
+}
 
-        sensor->temp  = 0;
+static int tsReadValid(DS18B20* sensor, char* addr)
+{
+    char config = sensor->scrPad[TS_CONFIG];        // a failed read can leave garbage in the scratch pad
+    int  por    = 0;
+    int  status = TS_OK;
+    int  i;
 
-        sensor->temp |= sensor->scrPad[0];
-        sensor->temp |= sensor->scrPad[1]<<8;
+    tsCheckPower();
 
-        return 0;
+    for(i = 0; i <= TS_RETRY; i++)
+    {
+        if(tsRunScript(tsScrConvert, addr, 0))
+            status = TS_ERR_PRESENCE;
+        else if(tsWaitConvert(config))
+            status = TS_ERR_TIMEOUT;
+        else
+            status = tsReadScratch(sensor, addr, TS_PROFILE_VERIFIED);
+
+        if(status != TS_OK)
+            continue;
+
+        // a sensor that reset during the conversion reads 85C, a second 85C confirms it is real
+        if(sensor->temp != TS_POR_TEMP || por)
+            return TS_OK;
+
+        por    = 1;
+        status = TS_ERR_POR;
     }
-    else return -1;
+
+    return status;
 }
 
-int tsReadSPad_sS(DS18B20* sensor)
+int tsReadTempValid(DS18B20* sensor)
 {
-    volatile int i;
-    if(!tsMstRst())
+    return tsReadValid(sensor, sensor->addr);
+}
+
+int tsReadTempValid_sS(DS18B20* sensor)
+{
+    return tsReadValid(sensor, 0);
+}
+
+
+
+
+
+
+
+int tsReadAll(DS18B20* sensors, int n)
+{
+    char config = TS_9BITS;
+    int  valid  = 0;
+    int  i;
+
+    // a single conversion for every sensor on the bus
+    if(tsConvertTemp())
+    {
+        for(i = 0; i < n; i++)
+            sensors[i].status = TS_ERR_PRESENCE;
+
+        return -1;
+    }
+
+    // a parasite powered bus waits for the slowest resolution
+    for(i = 0; i < n; i++)
     {
-        tsWriteByte(SKIP_ROM);
+        if(tsConvTicks(sensors[i].scrPad[TS_CONFIG]) > tsConvTicks(config))
+            config = sensors[i].scrPad[TS_CONFIG];
+    }
 
-        tsWriteByte(READ_SPAD);
-        tsReadData(sensor->scrPad, 9);
+    // a sensor holding the bus low makes every scratch pad on it meaningless
+    if(tsWaitConvert(config))
+    {
+        for(i = 0; i < n; i++)
+            sensors[i].status = TS_ERR_TIMEOUT;
 
-        sensor->temp  = 0;
+        return -1;
+    }
 
-        sensor->temp |= sensor->scrPad[0];
-        sensor->temp |= sensor->scrPad[1]<<8;
+    // then sweep through the scratch pads
+    for(i = 0; i < n; i++)
+    {
+        // the CRC is always checked unless only the temperature bytes were requested
+        sensors[i].status = tsReadScratch(&sensors[i], sensors[i].addr, tsReadProfile == TS_PROFILE_TEMP ? TS_PROFILE_TEMP : TS_PROFILE_VERIFIED);
 
-        return 0;
+        if(sensors[i].status == TS_OK)
+            valid++;
     }
-    else return -1;
+
+    return valid;
+}
+
+int tsReadSPadAs(DS18B20* sensor, char profile)
+{
+    return tsReadScratch(sensor, sensor->addr, profile);
+}
+
+int tsReadSPadAs_sS(DS18B20* sensor, char profile)
+{
+    return tsReadScratch(sensor, 0, profile);
+}
+
+int tsReadSPadAddr(char* addr, char* scrPad)
+{
+    return tsRunScript(tsScrReadCrc, addr, scrPad);
+}
+
+int tsReadSPad(DS18B20* sensor)
+{
+    return tsReadSPadAs(sensor, tsReadProfile);
+}
+
+int tsReadSPad_sS(DS18B20* sensor)
+{
+    return tsReadSPadAs_sS(sensor, tsReadProfile);
+}
+
+void tsSetReadProfile(char profile)
+{
+    tsReadProfile = profile;
 }
 
 
@@ -290,41 +832,21 @@ int tsReadSPad_sS(DS18B20* sensor)
 
 int tsWriteSpad(DS18B20* sensor, char alarmHi, char alarmLo, char config)
 {
-    if(!tsMstRst())
-    {
-        tsMatchAddr(*sensor);
-
-        tsWriteByte(WRITE_SPAD);
-        sensor->scrPad[TS_ALARM_HI] = alarmHi;
-        tsWriteByte(alarmHi);
-        sensor->scrPad[TS_ALARM_LO] = alarmLo;
-        tsWriteByte(alarmLo);
-        sensor->scrPad[TS_CONFIG] = config;
-        tsWriteByte(config);
+    sensor->scrPad[TS_ALARM_HI] = alarmHi;
+    sensor->scrPad[TS_ALARM_LO] = alarmLo;
+    sensor->scrPad[TS_CONFIG]   = config;
 
-        return 0;
-    }
-    else return -1;
+    // the 3 bytes are sent straight from the scratch pad of the sensor
+    return tsRunScript(tsScrWrite, sensor->addr, &sensor->scrPad[TS_ALARM_HI]);
 }
 
 int tsWriteSpad_sS(DS18B20* sensor, char alarmHi, char alarmLo, char config)
 {
-    volatile int i;
-    if(!tsMstRst())
-    {
-        tsWriteByte(SKIP_ROM);
-
-        tsWriteByte(WRITE_SPAD);
-        sensor->scrPad[TS_ALARM_HI] = alarmHi;
-        tsWriteByte(alarmHi);
-        sensor->scrPad[TS_ALARM_LO] = alarmLo;
-        tsWriteByte(alarmLo);
-        sensor->scrPad[TS_CONFIG] = config;
-        tsWriteByte(config);
+    sensor->scrPad[TS_ALARM_HI] = alarmHi;
+    sensor->scrPad[TS_ALARM_LO] = alarmLo;
+    sensor->scrPad[TS_CONFIG]   = config;
 
-        return 0;
-    }
-    else return -1;
+    return tsRunScript(tsScrWrite, 0, &sensor->scrPad[TS_ALARM_HI]);
 }
 
 
@@ -336,7 +858,7 @@ int tsWriteSpad_sS(DS18B20* sensor, char alarmHi, char alarmLo, char config)
 
 int tsConfig(DS18B20* sensor, char config)
 {
-    if(!tsReadSPad(sensor))
+    if(!tsReadSPadAs(sensor, TS_PROFILE_VERIFIED))
     {
         if( !tsWriteSpad(sensor, sensor->scrPad[TS_ALARM_HI], sensor->scrPad[TS_ALARM_LO], config) )
         {
@@ -350,7 +872,7 @@ int tsConfig(DS18B20* sensor, char config)
 
 int tsConfig_sS(DS18B20* sensor, char config)
 {
-    if(!tsReadSPad_sS(sensor))
+    if(!tsReadSPadAs_sS(sensor, TS_PROFILE_VERIFIED))
     {
         if( !tsWriteSpad_sS(sensor, sensor->scrPad[TS_ALARM_HI], sensor->scrPad[TS_ALARM_LO], config) )
         {
@@ -371,7 +893,7 @@ int tsConfig_sS(DS18B20* sensor, char config)
 
 int tsSetAlarm(DS18B20* sensor, char alarmHi, char alarmLo)
 {
-    if(!tsReadSPad(sensor))
+    if(!tsReadSPadAs(sensor, TS_PROFILE_VERIFIED))
     {
         if( !tsWriteSpad(sensor, alarmHi, alarmLo, sensor->scrPad[TS_CONFIG]) )
             return 0;
@@ -382,7 +904,7 @@ int tsSetAlarm(DS18B20* sensor, char alarmHi, char alarmLo)
 
 int tsSetAlarm_sS(DS18B20* sensor, char alarmHi, char alarmLo)
 {
-    if(!tsReadSPad_sS(sensor))
+    if(!tsReadSPadAs_sS(sensor, TS_PROFILE_VERIFIED))
     {
         if( !tsWriteSpad_sS(sensor, alarmHi, alarmLo, sensor->scrPad[TS_CONFIG]) )
             return 0;
@@ -398,30 +920,225 @@ int tsSetAlarm_sS(DS18B20* sensor, char alarmHi, char alarmLo)
 
 
 
-int tsCopySpad(DS18B20 sensor)
+void tsAdaptInit(DS18B20Adapt* adapt, DS18B20* sensor)
 {
-    if(!tsMstRst())
-        {
-            tsMatchAddr(sensor);
-            tsWriteByte(COPY_SPAD);
+    adapt->rate    = 0;
+    adapt->samples = 0;
+    adapt->config  = sensor->scrPad[TS_CONFIG];
+}
 
-            while(!tsReadBit());
+char tsAdaptUpdate(DS18B20Adapt* adapt, DS18B20* sensor)
+{
+    int  delta, margin;
+    char config;
 
-            return 0;
-        }
-    else return -1;
+    // the rate is an exponential average of the absolute change over about 4 samples
+    if(adapt->samples)
+    {
+        delta = sensor->temp - adapt->lastTemp;
+
+        if(delta < 0)
+            delta = -delta;
+
+        adapt->rate += delta - (adapt->rate >> 2);
+    }
+
+    adapt->lastTemp = sensor->temp;
+    adapt->samples  = 1;
+
+    // distance to the closest alarm threshold, the thresholds are in whole degrees
+    margin = ((signed char)sensor->scrPad[TS_ALARM_HI] << 4) - sensor->temp;
+    delta  = sensor->temp - ((signed char)sensor->scrPad[TS_ALARM_LO] << 4);
+
+    if(delta < margin)
+        margin = delta;
+
+    if(margin < TS_ADAPT_MARGIN || adapt->rate >= TS_ADAPT_FAST * 4)
+        config = TS_12BITS;
+    else if(adapt->rate >= TS_ADAPT_SLOW * 4 && TS_ADAPT_MIN < TS_10BITS)
+        config = TS_10BITS;
+    else
+        config = TS_ADAPT_MIN;
+
+    // going up is immediate, going down is one step per sample
+    if(config < adapt->config && adapt->config > TS_9BITS && adapt->config <= TS_12BITS)
+        config = adapt->config - (TS_10BITS - TS_9BITS);
+
+    return config;
 }
 
-int tsCopySpad_sS(DS18B20 sensor)
+static int tsAdaptApply(DS18B20* sensor, DS18B20Adapt* adapt, char config, char singleSensor)
 {
-    if(!tsMstRst())
-        {
-            tsWriteByte(SKIP_ROM);
-            tsWriteByte(COPY_SPAD);
+    int status;
 
-            while(!tsReadBit());
+    // the scratch pad is only written when the resolution changes
+    if(config == adapt->config)
+        return 0;
 
-            return 0;
-        }
-    else return -1;
+    // the last read may not have fetched or checked the alarm thresholds, tsConfig writes them back from a verified read
+    if(singleSensor)
+        status = tsConfig_sS(sensor, config);
+    else
+        status = tsConfig(sensor, config);
+
+    if(status)
+        return -1;
+
+    adapt->config = config;
+
+    return 0;
+}
+
+int tsReadTempAdapt(DS18B20* sensor, DS18B20Adapt* adapt)
+{
+    int status = tsReadTemp(sensor);
+
+    if(status)
+        return status;
+
+    return tsAdaptApply(sensor, adapt, tsAdaptUpdate(adapt, sensor), 0);
+}
+
+int tsReadTempAdapt_sS(DS18B20* sensor, DS18B20Adapt* adapt)
+{
+    int status = tsReadTemp_sS(sensor);
+
+    if(status)
+        return status;
+
+    return tsAdaptApply(sensor, adapt, tsAdaptUpdate(adapt, sensor), 1);
+}
+
+
+
+
+
+
+
+
+int tsCopySpad(DS18B20* sensor)
+{
+    int status;
+
+    tsCheckPower();
+
+    // a failed script keeps its own error, so an overrun isn't taken for a missing sensor
+    status = tsRunScript(tsScrCopy, sensor->addr, 0);
+
+    if(status)
+        return status;
+
+    return tsWaitCopy();
+}
+
+int tsCopySpad_sS(DS18B20* sensor)
+{
+    int status;
+
+    tsCheckPower();
+
+    status = tsRunScript(tsScrCopy, 0, 0);
+
+    if(status)
+        return status;
+
+    return tsWaitCopy();
+}
+
+
+
+
+
+
+
+
+unsigned int tsConvTicks(char config)
+{
+    // bits 0 to 4 of the configuration register always read as 1s
+    if((config & 0x1F) != 0x1F)
+        config = TS_12BITS;
+
+    return TS_CONV_TICKS << ((config >> 5) & 0x03);
+}
+
+int tsConvertStart(DS18B20* sensor, char mode, tsConvCallback done)
+{
+    if(tsConvState != TS_CONV_IDLE)
+        return -1;
+
+    tsCheckPower();
+
+    // a null sensor converts every sensor on the bus at once
+    if(tsRunScript(tsScrConvert, sensor ? sensor->addr : 0, 0))
+        return -1;
+
+    // a parasite powered bus can't be polled, it keeps the strong pull-up on until the deadline
+    if(tsSpuMask)
+        mode = TS_CONV_TIMED;
+
+    tsConvSensor = sensor;
+    tsConvDone   = done;
+    tsConvMode   = mode;
+    tsConvState  = TS_CONV_RUN;
+
+    // the deadline of a broadcast conversion is the one of the slowest resolution,
+    // a polled conversion gets the TS_CONV_US deadline in case the bus is never released
+    if(mode == TS_CONV_TIMED)
+        TA1CCR0 = tsConvTicks(sensor ? sensor->scrPad[TS_CONFIG] : TS_12BITS);
+    else
+        TA1CCR0 = ((tsConvUs(sensor ? sensor->scrPad[TS_CONFIG] : TS_12BITS) / 1000) * 32768 + 999) / 1000;
+
+    TA1CCTL0 = CCIE;
+    TA1CTL   = TASSEL_1|MC_1|TACLR;                     // ACLK in up mode
+
+    return 0;
+}
+
+int tsConvertPoll()
+{
+    int status = 0;
+    int done   = 0;
+
+    if(tsConvState == TS_CONV_IDLE)
+        return 0;
+
+    // a single read slot returns a 1 once the conversion is done
+    if(tsConvMode == TS_CONV_POLLED && tsReadBit())
+    {
+        TA1CTL   = MC_0;
+        TA1CCTL0 = 0;
+
+        tsConvState = TS_CONV_EXPIRED;
+        done        = 1;
+    }
+
+    if(tsConvState != TS_CONV_EXPIRED)
+        return TS_CONV_BUSY;
+
+    tsConvState = TS_CONV_IDLE;
+
+    // a polled conversion that expired on the timer never released the bus
+    if(tsConvMode == TS_CONV_POLLED && !done)
+        status = TS_ERR_TIMEOUT;
+    else if(tsConvSensor)
+        status = tsReadSPad(tsConvSensor);
+
+    if(tsConvDone)
+        tsConvDone(tsConvSensor, status);
+
+    return status;
+}
+
+#pragma vector = TIMER1_A0_VECTOR
+__interrupt void tsConvIsr()
+{
+    // the conversion deadline expired, stop the timer and wake up the CPU
+    TA1CTL   = MC_0;
+    TA1CCTL0 = 0;
+
+    TS_SPU_OFF;
+
+    tsConvState = TS_CONV_EXPIRED;
+
+    __bic_SR_register_on_exit(LPM3_bits);
 }
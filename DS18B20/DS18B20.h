@@ -24,6 +24,16 @@
 
 
 
+// 1-wire bit engines, TS_BACKEND selects which one is built (it can also be passed as a build option)
+#define TS_BACKEND_ASM      0                       // cycle counted assembly routines in ts_*.s
+#define TS_BACKEND_TIMER    1                       // Timer2_A generates the slots and samples the bus in ts_timer.c
+#define TS_BACKEND_UART     2                       // USCI_A0 and the DMA emulate the slots in ts_uart.c
+
+#ifndef TS_BACKEND
+#define TS_BACKEND          TS_BACKEND_ASM
+#endif
+
+
 // define input and output constants for the one-wire bus
 #define TS_BUS          P2IN                        // P2.2 is the input port for the 1-wire bus
 #define TS_OUT          P2OUT                       // P2.3 is driving an external pull-down transistor that will pull the bus low when needed
@@ -37,16 +47,69 @@
 #define TS_INBIT        BIT3                        // 1-wire bus is directly connected to P2.3
 
 
-#define TS_CYCLE_DELAY_W  18                        // amount of cycles needed to delay for the write bit
-#define TS_CYCLE_DELAY_R  11                        // amount of cycles needed to delay for the read bit
+/* All of the bus timing is generated from the frequency of MCLK (and SMCLK for the timer and UART
+   backends), so it is the only thing that must change when the system clock changes. Both can
+   also be passed as build options. They must be written without a suffix so the assembler can
+   read them, and any value above 32767 is already a long in C                                      */
+#ifndef TS_MCLK_HZ
+#define TS_MCLK_HZ      1048576                     // The MSP430F5529 MCLK is 1.048 MHz by default
+#endif
+
+#ifndef TS_SMCLK_HZ
+#define TS_SMCLK_HZ     TS_MCLK_HZ
+#endif
+
+
+// amount of clk cycles needed to achieve a certain amount of time, rounded to the closest cycle
+#define TS_CYCLES(us)   ((TS_MCLK_HZ / 1000 * (us) + 500) / 1000)
+#define TS_TICKS(us)    ((TS_SMCLK_HZ / 1000 * (us) + 500) / 1000)
+
+#define TS_15us         TS_CYCLES(15)
+#define TS_30us         TS_CYCLES(30)
+#define TS_45us         TS_CYCLES(45)
+#define TS_60us         TS_CYCLES(60)
+#define TS_480us        TS_CYCLES(480)
+
 
+/* padding of the slots in ts_*.s
 
-// The MSP430F5529 SCLK is 1.048 MHz, so these macros define the amount of clk cycles needed to achieve a certain amount of time
-#define TS_15us         16
-#define TS_30us         31
-#define TS_45us         47
-#define TS_60us         63
-#define TS_480us        503
+ * TS_PAD_LOW nops keep the bus low for at least 2us, which is already the case below 2 MHz
+ * TS_SAMPLE_LOOP iterations of 3 cycles (plus 2 to load the counter) delay the sample of a read slot
+   to about 9us after the falling edge, which is already the case at 1 MHz                          */
+#if TS_CYCLES(2) > 4
+#define TS_PAD_LOW      (TS_CYCLES(2) - 4)
+#else
+#define TS_PAD_LOW      0
+#endif
+
+#if TS_CYCLES(9) > (9 + TS_PAD_LOW + 2)
+#define TS_SAMPLE_LOOP  ((TS_CYCLES(9) - 9 - TS_PAD_LOW - 2) / 3)
+#define TS_SAMPLE_PAD   (2 + 3 * TS_SAMPLE_LOOP)
+#else
+#define TS_SAMPLE_LOOP  0
+#define TS_SAMPLE_PAD   0
+#endif
+
+
+// amount of iterations of the 3 cycle delay loops, rounded up so the slots are never too short
+#define TS_CYCLE_DELAY_W  ((TS_60us - 12 - TS_PAD_LOW + 2) / 3)                     // write slots (12 cycles outside of the loop)
+#define TS_CYCLE_DELAY_R  ((TS_60us - 42 - TS_PAD_LOW - TS_SAMPLE_PAD + 2) / 3)     // tsReadData slots (42 cycles, 9 of them for the CRC)
+#define TS_CYCLE_DELAY_RB ((TS_60us - 22 - TS_PAD_LOW - TS_SAMPLE_PAD + 2) / 3)     // tsReadBit slots (22 cycles)
+#define TS_CYCLE_DELAY_M  ((TS_60us - 23 - TS_PAD_LOW - TS_SAMPLE_PAD + 2) / 3)     // tsMbSlots slots (23 cycles)
+
+
+// reject clocks that can't fit the slots
+#if TS_CYCLE_DELAY_W < 1 || TS_CYCLE_DELAY_R < 1 || TS_CYCLE_DELAY_RB < 1 || TS_CYCLE_DELAY_M < 1
+#error "TS_MCLK_HZ is too slow to fit a 60us 1-wire slot"
+#endif
+
+#if (9 + TS_PAD_LOW + TS_SAMPLE_PAD) > TS_15us
+#error "TS_MCLK_HZ is too slow to sample a read slot within 15us"
+#endif
+
+#if TS_480us > 65535
+#error "TS_MCLK_HZ is too fast for the 16 bit delay counters"
+#endif
 
 
 #define TS_BUS_L        TS_OUT |=  TS_OUTBIT        // Since driving the bus low means writing a high to P2.2, this has been abstracted to simplify readability
@@ -55,6 +118,145 @@
 #define TS_BUS_IS_LOW   !(TS_BUS&TS_INBIT)
 
 
+/* interrupts during the slots of the assembly backend
+
+ * Interrupts are only masked from the start of a slot until the bus is released (write 1) or
+   sampled (read), and around the release of a write 0, so they wait a few us instead of a whole
+   transfer. The reset keeps them masked from the release of the bus until the presence sample
+ * An interrupt in the low pulse of a write 0 stretches it, so the slot is checked for a presence
+   pulse afterwards. If the sensors took it as a reset, tsRunScript runs the transaction again up
+   to TS_OVERRUN_RETRY times                                                                       */
+#ifndef TS_OVERRUN_RETRY
+#define TS_OVERRUN_RETRY    2
+#endif
+
+
+/* strong pull-up for parasite powered sensors
+
+ * A parasite powered DS18B20 can't be supplied by the pull-up resistor during a temperature
+   conversion or a copy to its EEPROM, so P2.6 switches a P-MOSFET that ties the bus to Vdd
+ * It is turned on right after the CONVERT_T or COPY_SPAD command and off once the operation is
+   done, and it is only used if READ_PSUPPLY found a parasite powered sensor on the bus          */
+#define TS_SPU_OUT      P2OUT
+#define TS_SPU_DIR      P2DIR
+#define TS_SPU_BIT      BIT6                        // P2.6 turns the strong pull-up on when high
+
+#define TS_SPU_ON       TS_SPU_OUT |=  TS_SPU_BIT
+#define TS_SPU_OFF      TS_SPU_OUT &= ~TS_SPU_BIT
+
+
+/* Timer2_A backend
+
+ * TA2.1 (P2.4) drives the pull-down transistor in reset/set mode, so the bus is pulled low when the
+   timer counts to TA2CCR0 and released when it counts to TA2CCR1
+ * The 1-wire bus is also connected to CCI2A (P2.5), which is latched when the timer counts to
+   TA2CCR2 to sample read slots
+ * Write slots queue the next bit from the TA2CCR2 event, once the bus is released even for a 0, and
+   the new TA2CCR1 must be loaded before the next slot releases the bus. The slots are timed by the
+   timer, but an interrupt that keeps the ISR from running for longer than that writes the wrong
+   bit, so the other ISRs must stay shorter than the budget. MCLK must be at least as fast as SMCLK
+ * The timer runs from SMCLK, and the compare registers hold the amount of ticks minus 1           */
+#define TS_TA_OUTBIT        BIT4                    // TA2.1 is driving the pull-down transistor
+#define TS_TA_INBIT         BIT5                    // CCI2A is directly connected to the 1-wire bus
+
+#define TS_TA_SLOT          (TS_TICKS(70) - 1)      // period of a slot
+#define TS_TA_LOW_1         (TS_TICKS(2) - 1)       // bus low for 2us to write a 1 or start a read slot
+#define TS_TA_LOW_0         (TS_TICKS(60) - 1)      // bus low for 60us to write a 0
+#define TS_TA_SAMPLE        (TS_TICKS(12) - 1)      // read slots are sampled 12us after the falling edge
+#define TS_TA_QUEUE         (TS_TA_LOW_0 + 1)       // write slots queue the next bit right after the release of a 0
+#define TS_TA_RST_SLOT      (TS_TICKS(970) - 1)     // reset: 481us low and 489us for the presence pulse
+#define TS_TA_RST_LOW       (TS_TICKS(481) - 1)     // reset pulse
+#define TS_TA_RST_SAMPLE    (TS_TICKS(541) - 1)     // presence pulse sampled 60us after the bus is released
+
+// worst case cycles from the TA2CCR2 event until TA2CCR1 is loaded, interrupt latency included
+#ifndef TS_TA_ISR_CYCLES
+#define TS_TA_ISR_CYCLES    64
+#endif
+
+#if TS_TICKS(970) > 65535
+#error "TS_SMCLK_HZ is too fast for the Timer2_A backend"
+#endif
+
+#if TS_BACKEND == TS_BACKEND_TIMER && (TS_TA_SLOT - TS_TA_QUEUE + TS_TA_LOW_1 + 2) < TS_TA_ISR_CYCLES
+#error "TS_SMCLK_HZ is too slow for the Timer2_A ISR to queue a bit between two write slots"
+#endif
+
+
+/* USCI_A0 backend
+
+ * UCA0TXD (P3.3) drives the bus through a non-inverting open-drain buffer and UCA0RXD (P3.4) is
+   directly connected to the bus, so every UART byte sent is read back as the bus saw it
+ * A reset is a 0xF0 sent at 9600 baud, and it reads back something else if a sensor answered with a
+   presence pulse
+ * Every slot is a byte sent at 115200 baud: a 0xFF writes a 1 or starts a read slot and reads back a
+   0xFF if the bus stayed high, and a 0x00 holds the bus low for 78us to write a 0
+ * DMA0 feeds UCA0TXBUF and DMA1 empties UCA0RXBUF, so the CPU sleeps in LPM0 during the transfer
+ * The UART runs from SMCLK, the dividers and modulation are rounded like in the USCI user guide   */
+#define TS_UART_TXBIT       BIT3                    // P3.3 is UCA0TXD
+#define TS_UART_RXBIT       BIT4                    // P3.4 is UCA0RXD
+
+#define TS_UART_DIV8(baud)  ((TS_SMCLK_HZ * 8 + (baud) / 2) / (baud))     // divider in 1/8, rounded
+#define TS_UART_BR(baud)    (TS_UART_DIV8(baud) >> 3)                       // a UCBRSx rounded up to 8 carries into it
+#define TS_UART_BRS(baud)   (TS_UART_DIV8(baud) & 7)
+
+#define TS_UART_BR_RST      TS_UART_BR(9600)        // 9600 baud divider
+#define TS_UART_BRS_RST     TS_UART_BRS(9600)
+#define TS_UART_BR_SLOT     TS_UART_BR(115200)      // 115200 baud divider
+#define TS_UART_BRS_SLOT    TS_UART_BRS(115200)
+
+#define TS_UART_RST_BYTE    0xF0
+#define TS_UART_ONE         0xFF
+#define TS_UART_ZERO        0x00
+
+#define TS_UART_TX_TRIG     17                      // DMA trigger of UCA0TXIFG
+#define TS_UART_RX_TRIG     16                      // DMA trigger of UCA0RXIFG
+#define TS_UART_MAX_BYTES   9                       // bytes moved per DMA transfer, each byte takes 8 slots
+
+// DMA_VECTOR is shared with the I2C driver, whose vector calls tsUartDmaIsr as well. Without the I2C driver, set
+// TS_UART_DMA_ISR to 1 so this backend defines DMA_VECTOR itself
+#ifndef TS_UART_DMA_ISR
+#define TS_UART_DMA_ISR     0
+#endif
+
+
+/* bus time of the shortest read slot of the backend, a wait on the bus is bounded by turning its
+   deadline into an amount of read slots so it never needs a timer                                 */
+#if TS_BACKEND == TS_BACKEND_TIMER
+#define TS_SLOT_US          70
+#elif TS_BACKEND == TS_BACKEND_UART
+#define TS_SLOT_US          87                      // 10 bits at 115200 baud
+#else
+#define TS_SLOT_US          61
+#endif
+
+
+/* multi-bus engine
+
+ * Up to 8 independent buses are driven in lockstep by ts_multi.s, bus n is read from P6.n and its
+   pull-down transistor is driven by P1.n
+ * A single write to TS_MB_OUT starts the slot on every bus and a single read of TS_MB_BUS samples
+   all of them, so 8 buses take the same bus time as one
+ * Every function takes a mask of the buses to be used, with bit n selecting bus n                 */
+#define TS_MB_BUS           P6IN                    // P6.0 to P6.7 are the inputs of the buses
+#define TS_MB_OUT           P1OUT                   // P1.0 to P1.7 drive the pull-down transistors
+
+#define TS_MB_INIT_INPORT   P6DIR
+#define TS_MB_INIT_OUTPORT  P1DIR
+
+#define TS_MB_SPU_OUT       P4OUT                   // P4.0 to P4.7 turn on the strong pull-up of each bus
+#define TS_MB_SPU_DIR       P4DIR
+
+#define TS_MB_BUSES         8                       // amount of buses, one per bit of the ports
+#define TS_MB_MAX_BYTES     9                       // bytes moved per call to tsMbSlots, each byte takes 8 slots
+
+/* interrupts during the slots of the multi-bus engine
+
+ * They are masked and checked the same way as in the single bus assembly backend. tsMbSlots sets
+   the bit of every bus that took a stretched slot as a reset in tsMbOverrun, and tsMbMstRst clears
+   the bits of the buses it resets, so the transactions run again up to TS_OVERRUN_RETRY times    */
+extern volatile char tsMbOverrun;
+
+
 // corresponding byte and its definition inside the scratchpad
 #define TS_TEMP_LSB     0
 #define TS_TEMP_MSB     1
@@ -73,7 +275,7 @@
 
 
 #define TS_RST_DELAY    (TS_480us - 3)                  // Needs three less cycles since it takes a couple of clk cycles to drive the outputs
-#define TS_RST_SAMPLE   210                             // Safe amount of clock cycles to sample whether the slave responded after a reset
+#define TS_RST_SAMPLE   TS_CYCLES(200)                  // Safe amount of clock cycles to sample whether the slave responded after a reset
 
 
 // ROM commands
@@ -93,6 +295,141 @@
 #define READ_PSUPPLY    0xB4        // read power supply command
 
 
+/* opcodes of the transaction scripts run by tsRunScript
+
+ * the opcodes followed by (n) or (byte) take the next byte of the script as their argument
+ * addr and buf are the arguments of tsRunScript                                                   */
+#define TS_OP_END           0x00    // end of the script
+#define TS_OP_RESET         0x01    // reset, the script stops with TS_ERR_PRESENCE if nobody answers
+#define TS_OP_CMD           0x02    // (byte) write a command
+#define TS_OP_ROM           0x03    // MATCH_ROM and the 8 bytes of addr, or SKIP_ROM if addr is 0
+#define TS_OP_WRITE         0x04    // (n) write n bytes from buf
+#define TS_OP_READ          0x05    // (n) read n bytes into buf
+#define TS_OP_READ_CRC      0x06    // (n) read n bytes into buf, the script stops with TS_ERR_CRC if they fail the CRC
+#define TS_OP_WAIT          0x07    // (n) read slots until the bus returns a 1, the script stops with TS_ERR_TIMEOUT after n blocks of TS_WAIT_BLOCK slots
+#define TS_OP_STRONG        0x08    // strong pull-up on, only if the bus is parasite powered
+#define TS_OP_LOAD_ADDR     0x09    // read 8 bytes into addr
+#define TS_OP_ABORT         0x0A    // reset to abort a read, nobody has to answer
+
+
+// scratch pad read profiles
+#define TS_PROFILE_FULL     0       // all 9 bytes are read without checking the CRC
+#define TS_PROFILE_TEMP     1       // only the temperature bytes are read, then a reset aborts the transfer
+#define TS_PROFILE_VERIFIED 2       // all 9 bytes are read and validated with the CRC
+
+
+// status codes
+#define TS_OK           0
+#define TS_ERR_PRESENCE -1          // no presence pulse after the reset
+#define TS_ERR_CRC      -2          // the ROM code or scratch pad failed the CRC
+#define TS_ERR_TIMEOUT  -3          // the conversion or copy wasn't done before its deadline
+#define TS_ERR_POR      -4          // the temperature was the power-on reset value and a new conversion didn't confirm it
+#define TS_ERR_OVERRUN  -5          // an interrupt stretched a slot into a reset every time the transaction was run
+
+#define TS_POR_TEMP     0x0550      // 85C, the temperature register of a sensor that never converted since it was powered
+
+#ifndef TS_RETRY
+#define TS_RETRY        2           // amount of times tsReadTempValid tries again after a failure
+#endif
+
+
+#define TS_SEARCH_RETRY 3           // amount of times a device is searched again if its ROM code fails the CRC
+
+#define TS_PROV_CHANGED 1           // status tsProvision gives a sensor while its EEPROM still has to be written
+
+
+// asynchronous temperature conversion
+#define TS_CONV_TIMED       0       // the conversion is complete once a deadline on Timer1_A expires
+#define TS_CONV_POLLED      1       // the conversion is complete once a read slot returns a 1
+
+#define TS_CONV_BUSY        1       // returned by tsConvertPoll while the conversion is running
+
+#define TS_CONV_TICKS       3072    // 93.75ms of ACLK (32768Hz) for a 9 bit conversion, it doubles for each extra bit
+
+
+// power supply of the sensors on a bus
+#define TS_POWER_UNKNOWN    -1      // READ_PSUPPLY wasn't answered yet
+#define TS_POWER_EXTERNAL   0       // every sensor has its own supply, the bus can be polled
+#define TS_POWER_PARASITE   1       // at least one sensor is powered by the bus
+
+#define TS_COPY_MS          10      // time the EEPROM takes to copy the scratch pad
+
+
+/* deadlines of the waits on the bus, a sensor that still holds the bus low after them is given up
+   with TS_ERR_TIMEOUT instead of stalling the firmware. They are counted in read slots of
+   TS_SLOT_US, in blocks of TS_WAIT_BLOCK slots so a script can hold them in a single byte          */
+#ifndef TS_CONV_US
+#define TS_CONV_US          100000  // 9 bit conversion (93.75ms in the datasheet), it doubles for each extra bit
+#endif
+
+#ifndef TS_COPY_US
+#define TS_COPY_US          20000   // copy of the scratch pad into the EEPROM
+#endif
+
+#define TS_WAIT_BLOCK       256
+#define TS_WAIT_BLOCKS(us)  (((us) + (unsigned long)TS_SLOT_US * TS_WAIT_BLOCK - 1) / ((unsigned long)TS_SLOT_US * TS_WAIT_BLOCK))
+
+#if (TS_CONV_US / 1000 * 8 * 32768 + 999) / 1000 > 65535
+#error "TS_CONV_US doesn't fit the 16 bit deadline of Timer1_A at 12 bits"
+#endif
+
+
+/* ROM code registry
+
+ * The sensors found are kept in information memory, one full copy of the registry per segment
+ * Every save goes to the next of the TS_REG_SEGMENTS segments (INFOD, INFOC and INFOB) with a
+   bigger sequence number, so the segments wear evenly and a save that is cut short leaves the
+   previous copy intact. INFOA is left alone since it can be locked                               */
+#define TS_REG_BASE         0x1800                  // INFOD
+#define TS_REG_SEG_SIZE     128
+#define TS_REG_SEGMENTS     3                       // INFOD, INFOC and INFOB
+#define TS_REG_ENTRIES      12                      // sensors that fit in a segment
+
+#define TS_REG_MAIN_BUS     TS_MB_BUSES             // bus index of the main bus, 0 to 7 are the multi-bus buses
+#define TS_FAMILY_CODE      0x28                    // first byte of the ROM code of every DS18B20
+
+
+/* compact sensor table
+
+ * The table keeps its columns apart instead of an array of DS18B20 structures: 6 bytes of serial,
+   2 bytes of temperature and 1 byte of state per sensor, so 200 sensors take 1.8 KB instead of 4.2
+ * The state byte keeps the resolution of the sensor in bits 0 and 1 (the same bits as bits 5 and 6
+   of the configuration register) and the negated status code of the last read in bits 2 to 4    */
+#ifndef TS_TABLE_SIZE
+#define TS_TABLE_SIZE       200
+#endif
+
+#define TS_STATE_RES        0x03
+#define TS_STATE_STATUS     0x1C
+
+#define TS_STATE(status, config)    ((char)(((-(status) << 2) & TS_STATE_STATUS) | (((config) >> 5) & TS_STATE_RES)))
+#define TS_STATE_GET_STATUS(state)  (-(int)(((state) & TS_STATE_STATUS) >> 2))
+#define TS_STATE_GET_CONFIG(state)  ((char)((((state) & TS_STATE_RES) << 5) | 0x1F))
+
+
+/* adaptive resolution, the rates are the average change between two samples in 1/16 C
+
+ * the resolution goes up to 12 bits as soon as the temperature is within TS_ADAPT_MARGIN of an
+   alarm threshold or changes faster than TS_ADAPT_FAST, to 10 bits if it changes faster than
+   TS_ADAPT_SLOW, and it falls back to TS_ADAPT_MIN while it is stable
+ * it only goes down one step per sample, so a single quiet sample doesn't drop the precision    */
+#ifndef TS_ADAPT_MIN
+#define TS_ADAPT_MIN        TS_9BITS
+#endif
+
+#ifndef TS_ADAPT_MARGIN
+#define TS_ADAPT_MARGIN     32      // 2 C
+#endif
+
+#ifndef TS_ADAPT_SLOW
+#define TS_ADAPT_SLOW       4       // 0.25 C per sample
+#endif
+
+#ifndef TS_ADAPT_FAST
+#define TS_ADAPT_FAST       16      // 1 C per sample
+#endif
+
+
 
 
 
@@ -106,9 +443,83 @@ typedef struct DS18B20
     char addr[8];
     char scrPad[9];
     int  temp;
+    int  status;                    // status code of the last batch read
 } DS18B20;
 
 
+/* search state used by the search ROM algorithm
+
+ * it keeps the last ROM found and the branch point of the binary tree, so the search can be
+   resumed one device at a time with tsSearchNext                                                   */
+typedef struct DS18B20Search
+{
+    char addr[8];                   // ROM code of the last device found
+    char command;                   // ROM command used to start the search
+    int  lastDiscrepancy;           // bit position (1 to 64) of the last branch that took the 0 path
+    int  lastDevice;                // set once the last device on the bus has been found
+} DS18B20Search;
+
+
+// sensor table, sensor i is made of serial[i], temp[i] and state[i]
+typedef struct DS18B20Table
+{
+    char serial[TS_TABLE_SIZE][6];  // bytes 1 to 6 of the ROM code, the family code and CRC are rebuilt
+    int  temp[TS_TABLE_SIZE];       // temperature of the last read
+    char state[TS_TABLE_SIZE];      // resolution and status of the last read
+    int  count;
+} DS18B20Table;
+
+
+/* entry of the ROM code registry
+
+ * the family code and the CRC of the ROM code aren't kept since they can be rebuilt from the serial
+ * the configuration and the alarm thresholds are the ones the sensor had when it was saved       */
+typedef struct DS18B20Entry
+{
+    char serial[6];                 // bytes 1 to 6 of the ROM code
+    char bus;                       // TS_REG_MAIN_BUS or the index of a multi-bus bus
+    char config;
+    char alarmHi;
+    char alarmLo;
+} DS18B20Entry;
+
+
+// copy of the registry kept in each segment of information memory
+typedef struct DS18B20Registry
+{
+    unsigned int seq;               // bigger for newer copies, 0xFFFF for an erased segment
+    char         crc;               // CRC of count and the entries
+    char         count;
+    DS18B20Entry entries[TS_REG_ENTRIES];
+} DS18B20Registry;
+
+
+// alarm thresholds and resolution a sensor should keep in its EEPROM
+typedef struct DS18B20Setup
+{
+    char alarmHi;
+    char alarmLo;
+    char config;
+} DS18B20Setup;
+
+
+/* state of the adaptive resolution of a sensor
+
+ * the rate is filtered over about 4 samples and kept 4 times larger so the filter doesn't lose
+   the small changes                                                                               */
+typedef struct DS18B20Adapt
+{
+    int  lastTemp;                  // temperature of the previous sample
+    int  rate;                      // filtered change between two samples, times 4
+    char config;                    // resolution written to the sensor
+    char samples;                   // set once lastTemp holds a sample
+} DS18B20Adapt;
+
+
+// called by tsConvertPoll once an asynchronous conversion is complete
+typedef void (*tsConvCallback)(DS18B20* sensor, int status);
+
+
 
 
 
@@ -130,6 +541,23 @@ typedef struct DS18B20
  **********************************************************************************************/
 char tsWriteByte(char byte);
 
+/**********************************************************************************************
+ * Function:    tsWriteByteStrong
+ *
+ * Description: - Sends 1 byte the same way as tsWriteByte and turns on the strong pull-up as
+ *                soon as the bus is released in the last slot
+ *              - A parasite powered sensor must get the strong pull-up within 10us of the end
+ *                of a CONVERT_T or COPY_SPAD, which leaves no time to return to the caller
+ *
+ * Input:       - byte => the byte transmitted
+ *              - spu  => the bits of TS_SPU_OUT to be turned on, 0 turns on none
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the value of byte
+ **********************************************************************************************/
+char tsWriteByteStrong(char byte, char spu);
+
 /**********************************************************************************************
  * Function:    tsReadData
  *
@@ -143,6 +571,21 @@ char tsWriteByte(char byte);
  **********************************************************************************************/
 char* tsReadData(char* byte, int bufLen);
 
+/**********************************************************************************************
+ * Function:    tsReadDataCrc
+ *
+ * Description: - Reads n-bytes of data through the 1-wire bus the same way as tsReadData
+ *              - The CRC-8 is calculated while the bits are being read, so it is ready as soon
+ *                as the transfer ends
+ *
+ * Input:       - bufLen => the amount of bytes being received
+ *
+ * Output:      - byte   => an array of bytes with the input data
+ *
+ * Return:      - Returns the CRC of the bytes read, which is 0 if the last byte was a valid CRC
+ **********************************************************************************************/
+char tsReadDataCrc(char* byte, int bufLen);
+
 /**********************************************************************************************
  * Function:    tsReadBit
  *
@@ -169,6 +612,45 @@ int tsReadBit();
  **********************************************************************************************/
 void tsWriteBit(char polarity);
 
+/**********************************************************************************************
+ * Function:    tsRunScript
+ *
+ * Description: - Runs a whole transaction from a script of TS_OP_* opcodes, so the bytes of the
+ *                transaction are sent back to back
+ *              - It is a single assembly routine (ts_script.s) with the assembly backend, and
+ *                the same interpreter in C with the other backends
+ *
+ * Input:       - script    => the opcodes, ended by TS_OP_END
+ *              - addr      => the ROM code used by TS_OP_ROM, or 0 to use SKIP_ROM
+ *              - buf       => the buffer used by TS_OP_WRITE and TS_OP_READ
+ *
+ * Output:      - buf       => the bytes read
+ *              - addr      => the ROM code read by TS_OP_LOAD_ADDR
+ *
+ * Return:      - Returns TS_OK if the whole script ran, TS_ERR_PRESENCE if a reset wasn't
+ *                answered, TS_ERR_CRC if a TS_OP_READ_CRC failed and TS_ERR_TIMEOUT if a
+ *                TS_OP_WAIT reached its deadline
+ *              - Returns TS_ERR_OVERRUN if an interrupt still broke the transaction after
+ *                running it again TS_OVERRUN_RETRY times
+ **********************************************************************************************/
+int tsRunScript(const char* script, char* addr, char* buf);
+
+/**********************************************************************************************
+ * Function:    tsUartDmaIsr
+ *
+ * Description: - Handles the DMA interrupt of the USCI_A0 backend
+ *              - It is only needed if TS_UART_DMA_ISR is 0, in which case it is called by the
+ *                DMA_VECTOR ISR of the I2C driver, or else by the one of the application
+ *
+ * Input:       - None
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns a 1 if a 1-wire transfer is complete and the CPU must leave LPM0,
+ *                otherwise returns a 0
+ **********************************************************************************************/
+int tsUartDmaIsr();
+
 /**********************************************************************************************
  * Function:    tsInit
  *
@@ -228,137 +710,1062 @@ int tsMstRst();
  **********************************************************************************************/
 int tsGetAddr(DS18B20* sensor);
 
+/**********************************************************************************************
+ * Function:    tsSearchInit
+ *
+ * Description: - Resets the search state so the next call to tsSearchNext starts from the
+ *                first device on the bus
+ *
+ * Input:       - None
+ *
+ * Output:      - search    => the search state to be reset
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsSearchInit(DS18B20Search* search);
+
+/**********************************************************************************************
+ * Function:    tsSearchNext
+ *
+ * Description: - Runs one pass of the search ROM algorithm and finds the next device on the bus
+ *              - The ROM code found is validated with its CRC before being accepted
+ *              - If the CRC fails, the search state is left untouched so the same device can
+ *                be searched again by calling this function one more time
+ *              - A device with another family code is skipped, the search goes on with the
+ *                next device
+ *
+ * Input:       - search    => the search state from the previous call
+ *
+ * Output:      - search    => search->addr holds the ROM code of the device found
+ *
+ * Return:      - Returns a 0 if a device was found, a -1 if no sensor responded or all devices
+ *                were already found, a -2 if the ROM code failed the CRC, and a -5 if an
+ *                interrupt stretched a slot into a reset
+ **********************************************************************************************/
+int tsSearchNext(DS18B20Search* search);
+
+/**********************************************************************************************
+ * Function:    tsSearchNextRetry
+ *
+ * Description: - Same as tsSearchNext, but a ROM code that failed the CRC or was overrun by
+ *                an interrupt is searched again, up to TS_SEARCH_RETRY times
+ *
+ * Input:       - search    => the search state from the previous call
+ *
+ * Output:      - search    => search->addr holds the ROM code of the device found
+ *
+ * Return:      - The same as tsSearchNext, with the error of the last try
+ **********************************************************************************************/
+int tsSearchNextRetry(DS18B20Search* search);
+
+/**********************************************************************************************
+ * Function:    tsSearchRom
+ *
+ * Description: - Finds the address of every sensor on the bus in one pass
+ *              - Each device is searched again up to TS_SEARCH_RETRY times if its ROM code
+ *                fails the CRC
+ *
+ * Input:       - maxSensors => the size of the sensors array
+ *
+ * Output:      - sensors   => an array of structures that will hold the address of each sensor
+ *
+ * Return:      - Returns the number of sensors found
+ **********************************************************************************************/
+int tsSearchRom(DS18B20* sensors, int maxSensors);
+
+/**********************************************************************************************
+ * Function:    tsAlarmSearchInit
+ *
+ * Description: - Resets the search state so tsSearchNext only finds the sensors with the alarm
+ *                flag set (temperature above TH or below TL on the last conversion)
+ *
+ * Input:       - None
+ *
+ * Output:      - search    => the search state to be reset
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsAlarmSearchInit(DS18B20Search* search);
+
+/**********************************************************************************************
+ * Function:    tsAlarmScan
+ *
+ * Description: - Converts the temperature of all sensors at once, then runs an alarm search
+ *                and reads the scratch pad of the sensors in alarm only
+ *              - The bus time scales with the number of alarms instead of the number of sensors
+ *
+ * Input:       - maxAlarms => the size of the alarms array
+ *
+ * Output:      - alarms    => an array of structures that will hold the address and the scratch
+ *                             pad of each sensor in alarm, and in status what tsReadSPad
+ *                             returned, so a scratch pad that couldn't be read isn't trusted
+ *
+ * Return:      - Returns the number of sensors in alarm, or a -1 if no sensor was detected
+ **********************************************************************************************/
+int tsAlarmScan(DS18B20* alarms, int maxAlarms);
+
 /**********************************************************************************************
  * Function:    tsMatchAddr
  *
- * Description: - Sends the 8 bytes of the ROM code through the bus
+ * Description: - Sends the match rom command and the 8 bytes of the ROM code through the bus
  *
- * Input:       - sensor    => a structure that contains all data for the sensor
+ * Input:       - addr      => the ROM code of the sensor (e.g. sensor->addr)
  *
  * Output:      - None
  *
  * Return:      - Nothing
  **********************************************************************************************/
-void tsMatchAddr(DS18B20 sensor);
+void tsMatchAddr(char* addr);
 
 /**********************************************************************************************
  * Function:    tsConvertTemp
  *
  * Description: - Sends the convert temperature command to all sensors in the bus at the same
  *              time
+ *              - On a parasite powered bus the strong pull-up is left on, so tsWaitConvert must
+ *                be called right after
  *
  * Input:       - None
  *
  * Output:      - None
  *
- * Return:      - Nothing
+ * Return:      - Returns a 0 if the sensors were detected, and a -1 if no sensor was detected
  **********************************************************************************************/
-void tsConvertTemp();
+int tsConvertTemp();
 
 /**********************************************************************************************
- * Function:    tsValidateData
+ * Function:    tsReadPower
  *
- * Description: - Decodes the CRC register to validate the scratch pad
+ * Description: - Sends the read power supply command to find out whether any sensor on the bus
+ *                is parasite powered
+ *              - The result is kept, so the functions that convert the temperature or copy the
+ *                scratch pad know whether they need the strong pull-up. They call it on their
+ *                own the first time, so it only needs to be called again if the sensors change
  *
- * Input:       - sensor    => a structure that contains all data for the sensor
+ * Input:       - None
  *
  * Output:      - None
  *
- * Return:      - Returns a 0 if the scratch pad was valid, and a -1 if invalid
+ * Return:      - Returns TS_POWER_EXTERNAL or TS_POWER_PARASITE, and a -1 if no sensor was
+ *                detected
  **********************************************************************************************/
-int tsValidateData(DS18B20 sensor);
+int tsReadPower();
 
 /**********************************************************************************************
- * Function:    tsReadTemp
+ * Function:    tsWaitConvert
  *
- * Description: - Converts the current temperature from the BS18D20 and stores it in the sensor
+ * Description: - Waits until the temperature conversion started on the bus is done
+ *              - On an externally powered bus it polls the bus with read slots, which returns
+ *                as soon as the sensors are done, and gives up once the TS_CONV_US deadline of
+ *                the resolution given is over
+ *              - On a parasite powered bus the bus can't be polled, so it keeps the strong
+ *                pull-up on for the conversion time of the resolution given and then turns it
+ *                off
  *
- * Input:       - None
+ * Input:       - config    => the configuration register of the slowest sensor converting, an
+ *                             invalid one waits for a 12 bit conversion
  *
- * Output:      - sensor   => a structure that contains all the data from the sensor
+ * Output:      - None
  *
- * Return:      - Returns a 0 if temperature was converted and the second reset signal was valid
- *                otherwise returns a -1 if it fails
+ * Return:      - Returns TS_OK once the conversion is done, or TS_ERR_TIMEOUT if the bus was
+ *                still low at the deadline
  **********************************************************************************************/
-int tsReadTemp(DS18B20* sensor);
-int tsReadTemp_sS(DS18B20* sensor);
+int tsWaitConvert(char config);
 
 /**********************************************************************************************
- * Function:    tsReadSPad
+ * Function:    tsWaitCopy
  *
- * Description: - Reads the scratchpad of the sensor
+ * Description: - Waits until the scratch pad is copied into the EEPROM, the same way as
+ *                tsWaitConvert but for the TS_COPY_MS of the copy and the TS_COPY_US deadline
  *
  * Input:       - None
  *
- * Output:      - sensor    => a structure that contains all data for the sensor
+ * Output:      - None
  *
- * Return:      - Returns a 0 if the sensor was detected, and a -1 if no sensor was detected
+ * Return:      - Returns TS_OK once the copy is done, or TS_ERR_TIMEOUT if the bus was still
+ *                low at the deadline
  **********************************************************************************************/
-int tsReadSPad(DS18B20* sensor);
-int tsReadSPad_sS(DS18B20* sensor);
+int tsWaitCopy();
 
 /**********************************************************************************************
- * Function:    tsWriteSpad
+ * Function:    tsValidateData
  *
- * Description: - Writes the alarm high triger and low trigger, as well as configuring the
- *              resolution of the sensor
+ * Description: - Decodes the CRC register to validate the scratch pad
  *
  * Input:       - sensor    => a structure that contains all data for the sensor
- *              - alarmHi   => the high temperature trigger
- *              - alarmLo   => the low temperature trigger
- *              - config    => the resolution that of the temperature
  *
- * Output:      - sensor    => a structure that contains all data for the sensor
+ * Output:      - None
  *
- * Return:      - Returns a 0 if the sensor was detected, and a -1 if no sensor was detected
+ * Return:      - Returns a 0 if the scratch pad was valid, and a -1 if invalid
  **********************************************************************************************/
-int tsWriteSpad(DS18B20* sensor, char alarmHi, char alarmLo, char config);
-int tsWriteSpad_sS(DS18B20* sensor, char alarmHi, char alarmLo, char config);
+int tsValidateData(DS18B20* sensor);
 
 /**********************************************************************************************
- * Function:    tsConfig
+ * Function:    tsCalcCrc
  *
- * Description: - configures the resolution of the sensor
+ * Description: - Calculates the Maxim 1-wire CRC-8 (x^8 + x^5 + x^4 + 1) of a buffer
+ *              - It uses two 16 byte tables, one per nibble, instead of shifting each bit
+ *              - Running it over a ROM code or scratch pad that includes its CRC byte returns
+ *                a 0 if the data is valid
  *
- * Input:       - sensor    => a structure that contains all data for the sensor
- *              - config    => the resolution that of the temperature
+ * Input:       - data      => the bytes to be checked
+ *              - bufLen    => the amount of bytes
  *
- * Output:      - sensor    => a structure that contains all data for the sensor
+ * Output:      - None
  *
- * Return:      - Returns a 0 if the sensor was detected, and a -1 if no sensor was detected
+ * Return:      - Returns the CRC of the buffer
  **********************************************************************************************/
-int tsConfig(DS18B20* sensor, char config);
-int tsConfig_sS(DS18B20* sensor, char config);
+char tsCalcCrc(char* data, int bufLen);
 
 /**********************************************************************************************
- * Function:    tsSetAlarm
+ * Function:    tsAddrValid
  *
- * Description: - Writes the alarm high trigger and low trigger
+ * Description: - Checks that a ROM code belongs to a DS18B20 and passed its CRC
+ *              - A shorted bus reads an all 0 ROM code, which passes the CRC but not the
+ *                family code
  *
- * Input:       - sensor    => a structure that contains all data for the sensor
- *              - alarmHi   => the high temperature trigger
- *              - alarmLo   => the low temperature trigger
+ * Input:       - addr      => the ROM code to be checked
  *
- * Output:      - sensor    => a structure that contains all data for the sensor
+ * Output:      - None
  *
- * Return:      - Returns a 0 if the sensor was detected, and a -1 if no sensor was detected
+ * Return:      - Returns a 1 if the ROM code is valid, otherwise returns a 0
  **********************************************************************************************/
-int tsSetAlarm(DS18B20* sensor, char alarmHi, char alarmLo);
-int tsSetAlarm_sS(DS18B20* sensor, char alarmHi, char alarmLo);
+int tsAddrValid(char* addr);
 
 /**********************************************************************************************
- * Function:    tsCopySpad
+ * Function:    tsSPadTemp
  *
- * Description: - Copies the value of the alarm High, Low and configuration register into the
- *                internal EEPROM so the DS18B20 is properly setup at power up
+ * Description: - Assembles the temperature register out of a scratch pad
  *
- * Input:       - sensor    => a structure that contains all data for the sensor
+ * Input:       - scrPad    => the scratch pad read from a sensor
  *
  * Output:      - None
  *
- * Return:      - Returns a 0 if the scratch pad was valid, and a -1 if invalid
+ * Return:      - Returns the temperature in 1/16 C
+ **********************************************************************************************/
+int tsSPadTemp(const char* scrPad);
+
+/**********************************************************************************************
+ * Function:    tsSerialAddr
+ *
+ * Description: - Rebuilds a ROM code out of its 6 byte serial, with the DS18B20 family code
+ *                and the CRC
+ *
+ * Input:       - serial    => the 6 bytes between the family code and the CRC
+ *
+ * Output:      - addr      => the 8 byte ROM code
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsSerialAddr(char* addr, const char* serial);
+
+/**********************************************************************************************
+ * Function:    tsReadTemp
+ *
+ * Description: - Converts the current temperature from the BS18D20 and stores it in the sensor
+ *
+ * Input:       - None
+ *
+ * Output:      - sensor   => a structure that contains all the data from the sensor
+ *
+ * Return:      - Returns a 0 if temperature was converted and the second reset signal was valid
+ *                otherwise returns a -1 if it fails
+ *              - Returns a -2 if the scratch pad failed the CRC in the TS_PROFILE_VERIFIED
+ *                read profile, and a -3 if the conversion wasn't done before its deadline
+ *
+ * Note:        - tsReadTemp_sS reads the ROM code into sensor->addr until it holds a valid one,
+ *                then it uses SKIP_ROM and saves the 8 bytes of the ROM code on every read
+ **********************************************************************************************/
+int tsReadTemp(DS18B20* sensor);
+int tsReadTemp_sS(DS18B20* sensor);
+
+/**********************************************************************************************
+ * Function:    tsPipeStart_sS
+ *
+ * Description: - Starts the temperature pipeline of a bus with a single sensor
+ *              - The ROM code is read and validated with its CRC once, the resolution is read
+ *                from the scratch pad and the first conversion is started with SKIP_ROM
+ *
+ * Input:       - None
+ *
+ * Output:      - sensor    => the ROM code and scratch pad of the sensor
+ *
+ * Return:      - Returns TS_OK if the first conversion was started, TS_ERR_PRESENCE if no
+ *                sensor answered and TS_ERR_CRC if the ROM code or scratch pad kept failing
+ *                the CRC
+ **********************************************************************************************/
+int tsPipeStart_sS(DS18B20* sensor);
+
+/**********************************************************************************************
+ * Function:    tsPipeNext_sS
+ *
+ * Description: - Waits for the conversion started by the previous call (or tsPipeStart_sS),
+ *                reads the scratch pad with SKIP_ROM and starts the next conversion before
+ *                returning, so the conversion runs while the caller works on the reading
+ *              - Calling it in a loop samples at the fastest rate the resolution allows, since
+ *                the wait only covers the part of the conversion the caller didn't spend
+ *              - A parasite powered bus keeps the strong pull-up on between the calls, and
+ *                its wait always covers the whole conversion time
+ *              - The pipeline is started on its own by the first call
+ *
+ * Input:       - None
+ *
+ * Output:      - sensor    => a structure that contains all the data from the sensor
+ *
+ * Return:      - Returns the same as tsReadTemp
+ **********************************************************************************************/
+int tsPipeNext_sS(DS18B20* sensor);
+
+/**********************************************************************************************
+ * Function:    tsPipeStop_sS
+ *
+ * Description: - Waits for the conversion left running by tsPipeNext_sS, so the bus (and the
+ *                strong pull-up of a parasite powered bus) can be used for something else
+ *
+ * Input:       - sensor    => the sensor of the pipeline
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns TS_OK, or TS_ERR_TIMEOUT if the conversion wasn't done before its
+ *                deadline
+ **********************************************************************************************/
+int tsPipeStop_sS(DS18B20* sensor);
+
+/**********************************************************************************************
+ * Function:    tsReadTempValid
+ *
+ * Description: - Converts and reads the temperature like tsReadTemp, but the scratch pad is
+ *                always validated with the CRC and a failed attempt is tried again up to
+ *                TS_RETRY times
+ *              - 85C is also the temperature of a sensor that reset during its conversion, so
+ *                it is only accepted once a second conversion also returns it
+ *              - A sensor that is missing or holds the bus low costs at most (TS_RETRY + 1)
+ *                conversion deadlines plus about 10ms of bus time per attempt
+ *              - The _sS version uses SKIP_ROM instead of the address of the sensor
+ *
+ * Input:       - None
+ *
+ * Output:      - sensor   => a structure that contains all the data from the sensor, the
+ *                            temperature is only updated by a valid scratch pad
+ *
+ * Return:      - Returns TS_OK, or the status code of the last attempt: TS_ERR_PRESENCE,
+ *                TS_ERR_CRC, TS_ERR_TIMEOUT or TS_ERR_POR
+ **********************************************************************************************/
+int tsReadTempValid(DS18B20* sensor);
+int tsReadTempValid_sS(DS18B20* sensor);
+
+/**********************************************************************************************
+ * Function:    tsReadAll
+ *
+ * Description: - Converts the temperature of all sensors at once, waits for the conversion a
+ *                single time and then reads the scratch pad of each sensor
+ *              - The scratch pad of every sensor is validated with its CRC and the result is
+ *                stored in sensor->status (TS_OK, TS_ERR_PRESENCE or TS_ERR_CRC), except in
+ *                the TS_PROFILE_TEMP read profile where only the temperature bytes are read
+ *
+ * Input:       - n         => the amount of sensors in the array
+ *
+ * Output:      - sensors   => an array of structures with the address of each sensor
+ *
+ * Return:      - Returns the number of sensors read successfully, or a -1 if no sensor was
+ *                detected
+ **********************************************************************************************/
+int tsReadAll(DS18B20* sensors, int n);
+
+/**********************************************************************************************
+ * Function:    tsReadSPad
+ *
+ * Description: - Reads the scratchpad of the sensor
+ *              - The amount of bytes read depends on the profile set by tsSetReadProfile
+ *
+ * Input:       - None
+ *
+ * Output:      - sensor    => a structure that contains all data for the sensor
+ *
+ * Return:      - Returns a 0 if the sensor was detected, and a -1 if no sensor was detected
+ *              - Returns a -2 if the scratch pad failed the CRC in the TS_PROFILE_VERIFIED
+ *                read profile
+ **********************************************************************************************/
+int tsReadSPad(DS18B20* sensor);
+int tsReadSPad_sS(DS18B20* sensor);
+
+/**********************************************************************************************
+ * Function:    tsReadSPadAs
+ *
+ * Description: - Reads the scratchpad of the sensor in the given profile, whatever profile
+ *                was set by tsSetReadProfile
+ *
+ * Input:       - profile   => TS_PROFILE_FULL, TS_PROFILE_TEMP or TS_PROFILE_VERIFIED
+ *
+ * Output:      - sensor    => a structure that contains all data for the sensor
+ *
+ * Return:      - The same as tsReadSPad
+ **********************************************************************************************/
+int tsReadSPadAs(DS18B20* sensor, char profile);
+int tsReadSPadAs_sS(DS18B20* sensor, char profile);
+
+/**********************************************************************************************
+ * Function:    tsReadSPadAddr
+ *
+ * Description: - Reads all 9 bytes of the scratch pad of the sensor at addr and checks the
+ *                CRC, for the sensors that aren't kept in a DS18B20 structure
+ *              - It runs the same script as the TS_PROFILE_VERIFIED read, so a transfer broken
+ *                by an interrupt is run again
+ *
+ * Input:       - addr      => the ROM code of the sensor
+ *
+ * Output:      - scrPad    => the 9 bytes of the scratch pad
+ *
+ * Return:      - The same as tsRunScript
+ **********************************************************************************************/
+int tsReadSPadAddr(char* addr, char* scrPad);
+
+/**********************************************************************************************
+ * Function:    tsSetReadProfile
+ *
+ * Description: - Selects how tsReadTemp, tsReadSPad, tsReadAll and their _sS variants read
+ *                the scratch pad
+ *              - TS_PROFILE_FULL reads all 9 bytes without checking the CRC (default)
+ *              - TS_PROFILE_TEMP reads the 2 temperature bytes and resets the bus to abort
+ *                the transfer, which takes about 75% less bus time than a full read. Only use
+ *                it if the bus is known to be clean since the CRC can't be checked
+ *              - TS_PROFILE_VERIFIED reads all 9 bytes and validates them with the CRC
+ *              - tsReadAll always checks the CRC unless TS_PROFILE_TEMP is selected, and
+ *                tsConfig and tsSetAlarm always use a verified read
+ *
+ * Input:       - profile   => TS_PROFILE_FULL, TS_PROFILE_TEMP or TS_PROFILE_VERIFIED
+ *
+ * Output:      - None
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsSetReadProfile(char profile);
+
+/**********************************************************************************************
+ * Function:    tsWriteSpad
+ *
+ * Description: - Writes the alarm high triger and low trigger, as well as configuring the
+ *              resolution of the sensor
+ *
+ * Input:       - sensor    => a structure that contains all data for the sensor
+ *              - alarmHi   => the high temperature trigger
+ *              - alarmLo   => the low temperature trigger
+ *              - config    => the resolution that of the temperature
+ *
+ * Output:      - sensor    => a structure that contains all data for the sensor
+ *
+ * Return:      - Returns a 0 if the sensor was detected, and a -1 if no sensor was detected
+ **********************************************************************************************/
+int tsWriteSpad(DS18B20* sensor, char alarmHi, char alarmLo, char config);
+int tsWriteSpad_sS(DS18B20* sensor, char alarmHi, char alarmLo, char config);
+
+/**********************************************************************************************
+ * Function:    tsConfig
+ *
+ * Description: - configures the resolution of the sensor
+ *
+ * Input:       - sensor    => a structure that contains all data for the sensor
+ *              - config    => the resolution that of the temperature
+ *
+ * Output:      - sensor    => a structure that contains all data for the sensor
+ *
+ * Return:      - Returns a 0 if the sensor was detected, and a -1 if no sensor was detected
+ **********************************************************************************************/
+int tsConfig(DS18B20* sensor, char config);
+int tsConfig_sS(DS18B20* sensor, char config);
+
+/**********************************************************************************************
+ * Function:    tsSetAlarm
+ *
+ * Description: - Writes the alarm high trigger and low trigger
+ *
+ * Input:       - sensor    => a structure that contains all data for the sensor
+ *              - alarmHi   => the high temperature trigger
+ *              - alarmLo   => the low temperature trigger
+ *
+ * Output:      - sensor    => a structure that contains all data for the sensor
+ *
+ * Return:      - Returns a 0 if the sensor was detected, and a -1 if no sensor was detected
+ **********************************************************************************************/
+int tsSetAlarm(DS18B20* sensor, char alarmHi, char alarmLo);
+int tsSetAlarm_sS(DS18B20* sensor, char alarmHi, char alarmLo);
+
+/**********************************************************************************************
+ * Function:    tsAdaptInit
+ *
+ * Description: - Starts the adaptive resolution of a sensor from the resolution it has now
+ *              - The scratch pad of the sensor must have been read with all 9 bytes (e.g. with
+ *                tsReadSPad in the TS_PROFILE_VERIFIED profile), since its alarm thresholds are
+ *                written back every time the resolution changes
+ *
+ * Input:       - sensor    => a structure that contains all data for the sensor
+ *
+ * Output:      - adapt     => the state of the adaptive resolution of the sensor
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsAdaptInit(DS18B20Adapt* adapt, DS18B20* sensor);
+
+/**********************************************************************************************
+ * Function:    tsAdaptUpdate
+ *
+ * Description: - Feeds the last temperature of the sensor into the filtered rate of change and
+ *                picks the resolution of the next conversion
+ *
+ * Input:       - adapt     => the state of the adaptive resolution of the sensor
+ *              - sensor    => a structure with the last temperature read
+ *
+ * Output:      - adapt     => the filtered rate is updated
+ *
+ * Return:      - Returns the resolution for the next conversion (TS_9BITS to TS_12BITS)
+ **********************************************************************************************/
+char tsAdaptUpdate(DS18B20Adapt* adapt, DS18B20* sensor);
+
+/**********************************************************************************************
+ * Function:    tsReadTempAdapt
+ *
+ * Description: - Reads the temperature with tsReadTemp, then updates the adaptive resolution
+ *              - The configuration register is only written when the resolution changes, the
+ *                same way as tsConfig: the alarm thresholds are written back from a scratch pad
+ *                read that passed the CRC, so they are never overwritten with unchecked bytes
+ *              - The new resolution is only written to the scratch pad, not to the EEPROM
+ *
+ * Input:       - adapt     => the state of the adaptive resolution of the sensor
+ *
+ * Output:      - sensor    => a structure that contains all the data from the sensor
+ *
+ * Return:      - Returns the same as tsReadTemp, or a -1 if the new resolution couldn't be
+ *                written
+ **********************************************************************************************/
+int tsReadTempAdapt(DS18B20* sensor, DS18B20Adapt* adapt);
+int tsReadTempAdapt_sS(DS18B20* sensor, DS18B20Adapt* adapt);
+
+/**********************************************************************************************
+ * Function:    tsCopySpad
+ *
+ * Description: - Copies the value of the alarm High, Low and configuration register into the
+ *                internal EEPROM so the DS18B20 is properly setup at power up
+ *
+ * Input:       - sensor    => a structure that contains all data for the sensor
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns a 0 if the scratch pad was valid, a -1 if invalid, a -3 if the copy
+ *                wasn't done before its deadline, and a -5 if an interrupt overran every try
+ **********************************************************************************************/
+int tsCopySpad(DS18B20* sensor);
+int tsCopySpad_sS(DS18B20* sensor);
+
+/**********************************************************************************************
+ * Function:    tsConvertStart
+ *
+ * Description: - Sends the convert temperature command and returns right away
+ *              - In TS_CONV_TIMED mode, Timer1_A is started with a deadline that depends on the
+ *                resolution in the TS_CONFIG byte of the sensor, and the CPU can stay in LPM3
+ *                until the timer wakes it up. ACLK must be running at 32768Hz
+ *              - In TS_CONV_POLLED mode, every call to tsConvertPoll uses a single read slot to
+ *                check whether the conversion is done, and Timer1_A is started with the
+ *                TS_CONV_US deadline in case the sensor never releases the bus
+ *              - A parasite powered bus can't be polled, so it always uses TS_CONV_TIMED and the
+ *                strong pull-up is kept on until the deadline expires
+ *
+ * Input:       - sensor    => the sensor to be converted, or 0 to convert all sensors on the bus
+ *              - mode      => TS_CONV_TIMED or TS_CONV_POLLED
+ *              - done      => function called by tsConvertPoll once complete, it can be 0
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns a 0 if the conversion was started, and a -1 if a conversion is already
+ *                running or no sensor was detected
+ **********************************************************************************************/
+int tsConvertStart(DS18B20* sensor, char mode, tsConvCallback done);
+
+/**********************************************************************************************
+ * Function:    tsConvertPoll
+ *
+ * Description: - Checks whether the conversion started by tsConvertStart is complete
+ *              - Once complete, the scratch pad of the sensor is read (unless all sensors were
+ *                converted) and the done function is called with the result
+ *
+ * Input:       - None
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns TS_CONV_BUSY while the conversion is running, a 0 once it is complete
+ *                or if no conversion was started, a -1 if the scratch pad read failed, and
+ *                TS_ERR_TIMEOUT if a polled conversion wasn't done before its deadline
+ **********************************************************************************************/
+int tsConvertPoll();
+
+/**********************************************************************************************
+ * Function:    tsConvTicks
+ *
+ * Description: - Gets the maximum conversion time for a given resolution
+ *
+ * Input:       - config    => the configuration register of the sensor
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the conversion time in ACLK ticks, an invalid configuration register
+ *                returns the time of a 12 bit conversion
+ **********************************************************************************************/
+unsigned int tsConvTicks(char config);
+
+
+/**********************************************************************************************
+ * Function:    tsMbSlots
+ *
+ * Description: - Runs n slots on every selected bus at the same time (ts_multi.s)
+ *              - Each byte of slots has one bit per bus: a 1 releases the bus after the
+ *                wakeup pulse to write a 1 or start a read slot, and a 0 holds it low to
+ *                write a 0
+ *              - The port is sampled in every slot and written over the byte of that slot
+ *              - Interrupts are only masked for the start and the release of each slot, a bus
+ *                that took a stretched slot as a reset is set in tsMbOverrun
+ *
+ * Input:       - slots     => one byte per slot with the bit sent on each bus
+ *              - bitLen    => the amount of slots
+ *              - mask      => the buses to be used
+ *              - spu       => the bits of TS_MB_SPU_OUT turned on as soon as the buses are
+ *                             released in the last slot, 0 turns on none
+ *
+ * Output:      - slots     => one byte per slot with what each bus read
+ *
+ * Return:      - Returns the address of the first slot
+ **********************************************************************************************/
+char* tsMbSlots(char* slots, int bitLen, char mask, char spu);
+
+/**********************************************************************************************
+ * Function:    tsMbInit
+ *
+ * Description: - Initializes the pins of the selected buses, P6.n as the input of bus n, P1.n
+ *                as the output that drives its pull-down transistor and P4.n as the output that
+ *                drives its strong pull-up
+ *
+ * Input:       - mask      => the buses to be used
+ *
+ * Output:      - None
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsMbInit(char mask);
+
+/**********************************************************************************************
+ * Function:    tsMbMstRst
+ *
+ * Description: - Sends a reset signal through every selected bus at the same time
+ *              - Interrupts are masked from the release of the buses until the presence pulses
+ *                are sampled, and the bits of the buses reset are cleared from tsMbOverrun
+ *
+ * Input:       - mask      => the buses to be reset
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the mask of the buses where a slave responded
+ **********************************************************************************************/
+char tsMbMstRst(char mask);
+
+/**********************************************************************************************
+ * Function:    tsMbWriteByte
+ *
+ * Description: - Sends the same byte through every selected bus at the same time
+ *
+ * Input:       - mask      => the buses to be used
+ *              - byte      => the byte transmitted
+ *
+ * Output:      - None
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsMbWriteByte(char mask, char byte);
+
+/**********************************************************************************************
+ * Function:    tsMbWriteByteStrong
+ *
+ * Description: - Sends the same byte through every selected bus the same way as tsMbWriteByte
+ *                and turns on the strong pull-up of the spu buses as soon as they are released
+ *                in the last slot
+ *
+ * Input:       - mask      => the buses to be used
+ *              - byte      => the byte transmitted
+ *              - spu       => the buses whose strong pull-up is turned on
+ *
+ * Output:      - None
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsMbWriteByteStrong(char mask, char byte, char spu);
+
+/**********************************************************************************************
+ * Function:    tsMbWriteData
+ *
+ * Description: - Sends a different buffer through each selected bus at the same time
+ *              - The buffer of bus n starts at data + n * stride, so the stride can be the
+ *                size of a structure to send a field of an array of structures
+ *
+ * Input:       - mask      => the buses to be used
+ *              - data      => the buffer of bus 0
+ *              - stride    => the distance in bytes between the buffers of two buses
+ *              - bufLen    => the amount of bytes sent through each bus
+ *
+ * Output:      - None
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsMbWriteData(char mask, char* data, int stride, int bufLen);
+
+/**********************************************************************************************
+ * Function:    tsMbReadData
+ *
+ * Description: - Reads n-bytes from each selected bus at the same time
+ *              - The buffer of bus n starts at data + n * stride, the buffers of the buses
+ *                that aren't selected are left untouched
+ *
+ * Input:       - mask      => the buses to be used
+ *              - stride    => the distance in bytes between the buffers of two buses
+ *              - bufLen    => the amount of bytes read from each bus
+ *
+ * Output:      - data      => the buffer of bus 0
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsMbReadData(char mask, char* data, int stride, int bufLen);
+
+/**********************************************************************************************
+ * Function:    tsMbReadBit
+ *
+ * Description: - Reads 1 bit from every selected bus at the same time
+ *
+ * Input:       - mask      => the buses to be used
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the mask of the buses that were high
+ **********************************************************************************************/
+char tsMbReadBit(char mask);
+
+/**********************************************************************************************
+ * Function:    tsMbGetAddr
+ *
+ * Description: - Gets the address of the sensor on each selected bus at the same time
+ *              - ATTENTION: ONLY USE A SINGLE SENSOR ON EACH BUS WHEN CALLING THIS FUNCTION!
+ *
+ * Input:       - mask      => the buses to be used
+ *
+ * Output:      - sensors   => an array of structures, sensors[n] holds the address of the
+ *                             sensor on bus n
+ *
+ * Return:      - Returns the mask of the buses where the address was read and is a valid DS18B20
+ *                ROM code (tsAddrValid), the buses that still overran after TS_OVERRUN_RETRY
+ *                retries are left out
+ **********************************************************************************************/
+char tsMbGetAddr(DS18B20* sensors, char mask);
+
+/**********************************************************************************************
+ * Function:    tsMbConvertTemp
+ *
+ * Description: - Sends the convert temperature command to all sensors of every selected bus
+ *              - The power supply of the buses is found with tsMbReadPower the first time they
+ *                are used, and the strong pull-up of the parasite powered buses is left on, so
+ *                tsMbWaitConvert must be called right after
+ *
+ * Input:       - mask      => the buses to be used
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the mask of the buses where a sensor was detected and the command was
+ *                sent, the buses that still overran after TS_OVERRUN_RETRY retries are left out
+ *                and stay set in tsMbOverrun
+ **********************************************************************************************/
+char tsMbConvertTemp(char mask);
+
+/**********************************************************************************************
+ * Function:    tsMbReadPower
+ *
+ * Description: - Sends the read power supply command to every selected bus at the same time
+ *                and keeps the result for tsMbConvertTemp and tsMbWaitConvert
+ *
+ * Input:       - mask      => the buses to be used
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the mask of the buses with a parasite powered sensor
+ **********************************************************************************************/
+char tsMbReadPower(char mask);
+
+/**********************************************************************************************
+ * Function:    tsMbWaitConvert
+ *
+ * Description: - Waits until the conversion of every selected bus is done
+ *              - The externally powered buses are polled with read slots and are done as soon
+ *                as they return a 1, while the parasite powered buses keep their strong
+ *                pull-up on for the conversion time of the resolution given
+ *
+ * Input:       - mask      => the buses converting
+ *              - config    => the configuration register of the slowest sensor converting, an
+ *                             invalid one waits for a 12 bit conversion
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the mask of the polled buses that were still low after the TS_CONV_US
+ *                deadline of the resolution given
+ **********************************************************************************************/
+char tsMbWaitConvert(char mask, char config);
+
+/**********************************************************************************************
+ * Function:    tsMbReadSPad
+ *
+ * Description: - Reads the scratch pad of one sensor per bus at the same time, sensors[n] is
+ *                addressed on bus n
+ *              - The scratch pads are validated with their CRC and the result is stored in
+ *                sensors[n].status (TS_OK, TS_ERR_PRESENCE, TS_ERR_OVERRUN
+ *                or TS_ERR_CRC)
+ *              - With several sensors per bus, call it once per row of sensors after a single
+ *                tsMbConvertTemp
+ *
+ * Input:       - mask      => the buses to be used
+ *
+ * Output:      - sensors   => an array of structures with the address of each sensor
+ *
+ * Return:      - Returns the mask of the buses read successfully
+ **********************************************************************************************/
+char tsMbReadSPad(DS18B20* sensors, char mask);
+
+/**********************************************************************************************
+ * Function:    tsMbReadTemp
+ *
+ * Description: - Converts the temperature on every selected bus, waits until every bus is
+ *                done and then reads the scratch pad of one sensor per bus with tsMbReadSPad
+ *              - The parasite powered buses wait for the slowest resolution of the sensors
+ *              - The buses whose conversion was lost to an overrun aren't read and get
+ *                TS_ERR_OVERRUN
+ *
+ * Input:       - mask      => the buses to be used
+ *
+ * Output:      - sensors   => an array of structures with the address of each sensor
+ *
+ * Return:      - Returns the mask of the buses read successfully
+ **********************************************************************************************/
+char tsMbReadTemp(DS18B20* sensors, char mask);
+
+
+/**********************************************************************************************
+ * Function:    tsRegLoad
+ *
+ * Description: - Gets the newest valid copy of the registry from information memory
+ *
+ * Input:       - None
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the address of the registry in information memory, or a 0 if there is
+ *                no valid copy
+ **********************************************************************************************/
+const DS18B20Registry* tsRegLoad();
+
+/**********************************************************************************************
+ * Function:    tsRegSave
+ *
+ * Description: - Saves the ROM code, bus, resolution and alarm thresholds of every sensor into
+ *                the next segment of information memory
+ *              - Nothing is written if the registry already holds the same sensors, so the
+ *                flash is only erased when the set of sensors or their settings change
+ *              - Only the first TS_REG_ENTRIES sensors are saved
+ *
+ * Input:       - sensors   => an array of structures with the address and the scratch pad of
+ *                             each sensor
+ *              - buses     => the bus of each sensor (TS_REG_MAIN_BUS or a multi-bus bus)
+ *              - n         => the amount of sensors
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns a 0 if the registry is up to date, and a -1 if the flash failed
+ **********************************************************************************************/
+int tsRegSave(DS18B20* sensors, char* buses, int n);
+
+/**********************************************************************************************
+ * Function:    tsRegBoot
+ *
+ * Description: - Gets the sensors of the last boot from the registry and checks that each one
+ *                is still there by reading its scratch pad with MATCH_ROM
+ *              - Only the buses where a sensor is missing (or every bus if the registry is
+ *                empty) are searched again: the main bus with tsSearchRom and the multi-bus
+ *                buses with a READ_ROM, so they must only have a single sensor each. The
+ *                registry is then saved with tsRegSave
+ *
+ * Input:       - maxSensors => the size of the sensors and buses arrays
+ *              - mbMask    => the multi-bus buses in use, a 0 if only the main bus is used
+ *
+ * Output:      - sensors   => an array of structures with the address and the scratch pad of
+ *                             each sensor found
+ *              - buses     => the bus of each sensor found
+ *
+ * Return:      - Returns the number of sensors found
+ **********************************************************************************************/
+int tsRegBoot(DS18B20* sensors, char* buses, int maxSensors, char mbMask);
+
+
+/**********************************************************************************************
+ * Function:    tsTableInit
+ *
+ * Description: - Empties the sensor table
+ *
+ * Input:       - None
+ *
+ * Output:      - table     => the sensor table
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsTableInit(DS18B20Table* table);
+
+/**********************************************************************************************
+ * Function:    tsTableAdd
+ *
+ * Description: - Adds a sensor to the table, its resolution is set to 12 bits until it is read
+ *
+ * Input:       - table     => the sensor table
+ *              - addr      => the 8 bytes of the ROM code, it must be a DS18B20 with a valid CRC
+ *
+ * Output:      - table     => the sensor table
+ *
+ * Return:      - Returns the index of the sensor, and a -1 if the table is full or the ROM
+ *                code isn't valid
+ **********************************************************************************************/
+int tsTableAdd(DS18B20Table* table, char* addr);
+
+/**********************************************************************************************
+ * Function:    tsTableAddr
+ *
+ * Description: - Rebuilds the 8 bytes of the ROM code of a sensor in the table
+ *
+ * Input:       - table     => the sensor table
+ *              - index     => the index of the sensor
+ *
+ * Output:      - addr      => the 8 bytes of the ROM code
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsTableAddr(DS18B20Table* table, int index, char* addr);
+
+/**********************************************************************************************
+ * Function:    tsTableSearch
+ *
+ * Description: - Finds every sensor on the bus with the search ROM algorithm and adds it to the
+ *                table, the ROM codes go straight into the table without a DS18B20 array
+ *
+ * Input:       - table     => the sensor table
+ *
+ * Output:      - table     => the sensor table
+ *
+ * Return:      - Returns the number of sensors added
+ **********************************************************************************************/
+int tsTableSearch(DS18B20Table* table);
+
+/**********************************************************************************************
+ * Function:    tsTableRead
+ *
+ * Description: - Reads the scratch pad of a sensor in the table and keeps its temperature,
+ *                resolution and status, the scratch pad is validated with its CRC
+ *
+ * Input:       - table     => the sensor table
+ *              - index     => the index of the sensor
+ *
+ * Output:      - table     => the sensor table
+ *
+ * Return:      - Returns TS_OK, TS_ERR_PRESENCE, TS_ERR_CRC or TS_ERR_OVERRUN
+ **********************************************************************************************/
+int tsTableRead(DS18B20Table* table, int index);
+
+/**********************************************************************************************
+ * Function:    tsTableReadAll
+ *
+ * Description: - Converts the temperature of all sensors at once, waits for the slowest
+ *                resolution in the table and then reads every sensor with tsTableRead
+ *
+ * Input:       - table     => the sensor table
+ *
+ * Output:      - table     => the sensor table
+ *
+ * Return:      - Returns the number of sensors read successfully, or a -1 if no sensor was
+ *                detected
+ **********************************************************************************************/
+int tsTableReadAll(DS18B20Table* table);
+
+
+/**********************************************************************************************
+ * Function:    tsTempQ4
+ *
+ * Description: - Gets the temperature in 1/16 C with the bits that are undefined at the
+ *                resolution of the sensor cleared
+ *
+ * Input:       - temp      => the temperature register (e.g. sensor->temp)
+ *              - config    => the configuration register of the sensor, an invalid one is
+ *                             taken as 12 bits
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the temperature in 1/16 C
+ **********************************************************************************************/
+int tsTempQ4(int temp, char config);
+
+/**********************************************************************************************
+ * Function:    tsTempCenti
+ *
+ * Description: - Gets the temperature in 1/100 C with integer math only, rounded to the
+ *                closest 1/100 C
+ *              - tsTempCentiF does the same in 1/100 F
+ *
+ * Input:       - temp      => the temperature register (e.g. sensor->temp)
+ *              - config    => the configuration register of the sensor, an invalid one is
+ *                             taken as 12 bits
+ *
+ * Output:      - None
+ *
+ * Return:      - Returns the temperature in 1/100 C (or 1/100 F), e.g. 2506 for 25.0625 C
+ **********************************************************************************************/
+int tsTempCenti(int temp, char config);
+int tsTempCentiF(int temp, char config);
+
+/**********************************************************************************************
+ * Function:    tsTempCentiAll
+ *
+ * Description: - Converts an array of temperature registers to 1/100 C the same way as
+ *                tsTempCenti, in a single loop (e.g. the temp column of a DS18B20Table)
+ *
+ * Input:       - temp      => the temperature registers
+ *              - n         => the amount of temperatures
+ *              - config    => the configuration register shared by the sensors
+ *
+ * Output:      - centi     => the temperatures in 1/100 C, it can be the same array as temp
+ *
+ * Return:      - Nothing
+ **********************************************************************************************/
+void tsTempCentiAll(int* centi, const int* temp, int n, char config);
+
+
+/**********************************************************************************************
+ * Function:    tsProvision
+ *
+ * Description: - Writes the alarm thresholds and resolution of every sensor on the bus into
+ *                its EEPROM, but only for the sensors whose EEPROM differs from their setup
+ *              - The EEPROM of every sensor is recalled with a broadcast RECALL_E2 and compared
+ *                with a CRC checked read of its scratch pad
+ *              - If every sensor on the bus has to change to the same setup, they are all
+ *                written and copied with a single SKIP_ROM WRITE_SPAD and COPY_SPAD, so the bus
+ *                only waits for one copy. Otherwise each changed sensor is written and copied
+ *                on its own, so the EEPROM of a sensor that already matched is never rewritten
+ *              - ATTENTION: sensors must hold every sensor on the bus, since the broadcast
+ *                reaches all of them
+ *
+ * Input:       - setups    => the setup of each sensor
+ *              - n         => the amount of sensors
+ *
+ * Output:      - sensors   => the scratch pad of each sensor, and its status: TS_OK if its
+ *                             EEPROM holds its setup, otherwise the error that stopped it
+ *
+ * Return:      - Returns the number of sensors copied into their EEPROM, or a -1 if no sensor
+ *                was detected or the broadcast failed
  **********************************************************************************************/
-int tsCopySpad(DS18B20 sensor);
-int tsCopySpad_sS(DS18B20 sensor);
+int tsProvision(DS18B20* sensors, const DS18B20Setup* setups, int n);
 
 #endif /* DS18B20_H_ */
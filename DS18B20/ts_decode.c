@@ -0,0 +1,62 @@
+/*
+ * ts_decode.c
+ *
+ * Integer decode of the temperature register
+ *
+ * The temperature register is already fixed point with 4 fractional bits (1/16 C), so every unit
+ * is a multiply by a small constant and a shift. Nothing here needs the software float library.
+ */
+
+#include <msp430.h>
+#include "DS18B20.h"
+
+
+
+
+// bits of the temperature register that are defined at 9, 10, 11 and 12 bits
+static const int tsResMask[4] = {~7, ~3, ~1, ~0};
+
+
+
+
+static int tsResIndex(char config)
+{
+    // bits 0 to 4 of the configuration register always read as 1s
+    if((config & 0x1F) != 0x1F)
+        return 3;
+
+    return (config >> 5) & 0x03;
+}
+
+int tsTempQ4(int temp, char config)
+{
+    return temp & tsResMask[tsResIndex(config)];
+}
+
+int tsTempCenti(int temp, char config)
+{
+    temp &= tsResMask[tsResIndex(config)];
+
+    // 100/16 = 6.25, the quarter is rounded to the closest
+    return temp * 6 + ((temp + 2) >> 2);
+}
+
+int tsTempCentiF(int temp, char config)
+{
+    temp &= tsResMask[tsResIndex(config)];
+
+    // 100/16 * 9/5 = 11.25, and 32F in 1/100 F
+    return temp * 11 + ((temp + 2) >> 2) + 3200;
+}
+
+void tsTempCentiAll(int* centi, const int* temp, int n, char config)
+{
+    int mask = tsResMask[tsResIndex(config)];
+    int t;
+
+    while(n-- > 0)
+    {
+        t = *temp++ & mask;
+        *centi++ = t * 6 + ((t + 2) >> 2);
+    }
+}
@@ -0,0 +1,417 @@
+/*
+ * ts_multi.c
+ *
+ * Multi-bus engine, runs the same transaction on up to 8 buses in lockstep
+ *
+ * The bytes of every bus are sliced into one byte per slot with a bit per bus, tsMbSlots (ts_multi.s)
+ * sends them all at once and the bytes read are put back together bus by bus. The conversion and
+ * the scratch pad read of 8 buses take the same bus time as a single bus.
+ */
+
+#include <msp430.h>
+#include "DS18B20.h"
+
+
+
+// read slots that fit in the 1ms delay of tsMbWaitConvert, rounded up
+#define TS_MB_MS_SLOTS  ((1000 + TS_SLOT_US - 1) / TS_SLOT_US)
+
+static char tsMbSlotBuf[TS_MB_MAX_BYTES * 8];      // one byte per slot, bit n belongs to bus n
+
+static char tsMbPowerKnown = 0;                     // buses that answered READ_PSUPPLY
+static char tsMbParasite   = 0;                     // buses with a parasite powered sensor
+
+volatile char tsMbOverrun  = 0;                     // set by ts_multi.s for the buses that took a stretched slot as a reset
+
+
+
+
+static void tsMbSlice(char* slots, char* data, int stride, char mask)
+{
+    unsigned char bytes[TS_MB_BUSES];
+    unsigned char slot;
+    int bus, bit;
+
+    // the buses that aren't selected send 1s so they are never held low
+    for(bus = 0; bus < TS_MB_BUSES; bus++)
+        bytes[bus] = (mask & (1 << bus)) ? data[bus * stride] : 0xFF;
+
+    // slot n gets bit n of every bus, lsb first
+    for(bit = 0; bit < 8; bit++)
+    {
+        slot = 0;
+
+        for(bus = TS_MB_BUSES - 1; bus >= 0; bus--)
+        {
+            slot = (slot << 1) | (bytes[bus] & BIT0);
+            bytes[bus] >>= 1;
+        }
+
+        slots[bit] = slot;
+    }
+}
+
+static void tsMbGather(char* data, char* slots, int stride, char mask)
+{
+    unsigned char slot;
+    unsigned char bytes[TS_MB_BUSES] = {0};
+    int bus, bit;
+
+    // bit n of every bus comes from slot n, the slots are walked back so the lsb ends up last
+    for(bit = 7; bit >= 0; bit--)
+    {
+        slot = slots[bit];
+
+        for(bus = 0; bus < TS_MB_BUSES; bus++)
+        {
+            bytes[bus] = (bytes[bus] << 1) | (slot & BIT0);
+            slot >>= 1;
+        }
+    }
+
+    for(bus = 0; bus < TS_MB_BUSES; bus++)
+    {
+        if(mask & (1 << bus))
+            data[bus * stride] = bytes[bus];
+    }
+}
+
+
+
+
+void tsMbInit(char mask)
+{
+    TS_MB_OUT     &= ~mask;         // release the buses
+    TS_MB_SPU_OUT &= ~mask;
+
+    // initialize the gpio
+    TS_MB_INIT_INPORT  &= ~mask;
+    TS_MB_INIT_OUTPORT |=  mask;
+    TS_MB_SPU_DIR      |=  mask;
+}
+
+char tsMbMstRst(char mask)
+{
+    unsigned int gie = __get_SR_register() & GIE;
+    char presence;
+
+    // a new transaction starts in sync on every bus
+    tsMbOverrun &= ~mask;
+
+    // initital reset pulse on every bus, an interrupt can only make it longer
+    TS_MB_OUT |=  mask;
+    __delay_cycles(TS_RST_DELAY);
+
+    // the presence pulses must be sampled within 75us of the release
+    __disable_interrupt();
+
+    TS_MB_OUT &= ~mask;
+    __delay_cycles(TS_60us);
+
+    // the buses held low by a sensor answered the reset
+    presence = ~TS_MB_BUS & mask;
+
+    __bis_SR_register(gie);
+
+    __delay_cycles(TS_RST_DELAY);
+
+    return presence;
+}
+
+void tsMbWriteByte(char mask, char byte)
+{
+    tsMbWriteByteStrong(mask, byte, 0);
+}
+
+void tsMbWriteByteStrong(char mask, char byte, char spu)
+{
+    int bit;
+
+    for(bit = 0; bit < 8; bit++)
+    {
+        tsMbSlotBuf[bit] = (byte & BIT0) ? 0xFF : 0x00;
+        byte >>= 1;
+    }
+
+    tsMbSlots(tsMbSlotBuf, 8, mask, spu);
+}
+
+void tsMbWriteData(char mask, char* data, int stride, int bufLen)
+{
+    int chunk, i;
+
+    while(bufLen > 0)
+    {
+        chunk = (bufLen > TS_MB_MAX_BYTES) ? TS_MB_MAX_BYTES : bufLen;
+
+        for(i = 0; i < chunk; i++)
+            tsMbSlice(&tsMbSlotBuf[i * 8], data++, stride, mask);
+
+        tsMbSlots(tsMbSlotBuf, chunk * 8, mask, 0);
+
+        bufLen -= chunk;
+    }
+}
+
+void tsMbReadData(char mask, char* data, int stride, int bufLen)
+{
+    int chunk, i;
+
+    while(bufLen > 0)
+    {
+        chunk = (bufLen > TS_MB_MAX_BYTES) ? TS_MB_MAX_BYTES : bufLen;
+
+        // every slot is a read slot on every bus
+        for(i = 0; i < chunk * 8; i++)
+            tsMbSlotBuf[i] = 0xFF;
+
+        tsMbSlots(tsMbSlotBuf, chunk * 8, mask, 0);
+
+        for(i = 0; i < chunk; i++)
+            tsMbGather(data++, &tsMbSlotBuf[i * 8], stride, mask);
+
+        bufLen -= chunk;
+    }
+}
+
+char tsMbReadBit(char mask)
+{
+    tsMbSlotBuf[0] = 0xFF;
+
+    tsMbSlots(tsMbSlotBuf, 1, mask, 0);
+
+    return tsMbSlotBuf[0] & mask;
+}
+
+
+
+
+
+
+
+
+char tsMbGetAddr(DS18B20* sensors, char mask)
+{
+    char valid;
+    int  bus, retry = TS_OVERRUN_RETRY;
+
+    // only a single sensor per bus can answer a read rom command
+    do
+    {
+        valid = tsMbMstRst(mask);
+
+        if(!valid)
+            return 0;
+
+        tsMbWriteByte(valid, READ_ROM);
+        tsMbReadData(valid, sensors[0].addr, sizeof(DS18B20), 8);
+    }
+    while((tsMbOverrun & valid) && retry--);
+
+    // the buses that took a slot as a reset every time read a broken ROM code
+    valid &= ~tsMbOverrun;
+
+    // a shorted bus reads an all 0 ROM code, which passes the CRC but not the family code
+    for(bus = 0; bus < TS_MB_BUSES; bus++)
+    {
+        if((valid & (1 << bus)) && !tsAddrValid(sensors[bus].addr))
+            valid &= ~(1 << bus);
+    }
+
+    return valid;
+}
+
+char tsMbConvertTemp(char mask)
+{
+    char presence;
+    int  retry = TS_OVERRUN_RETRY;
+
+    // the power supply is only asked the first time a bus is used
+    if(mask & ~tsMbPowerKnown)
+        tsMbReadPower(mask & ~tsMbPowerKnown);
+
+    do
+    {
+        presence = tsMbMstRst(mask);
+
+        // send a skip rom command and convert the temperature of all sensors of every bus
+        if(presence)
+        {
+            tsMbWriteByte(presence, SKIP_ROM);
+
+            // the parasite powered sensors need the strong pull-up within 10us of the command
+            tsMbWriteByteStrong(presence, CONVERT_T, presence & tsMbParasite);
+        }
+    }
+    while((tsMbOverrun & presence) && retry--);
+
+    // the buses that took a slot as a reset every time never started the conversion
+    TS_MB_SPU_OUT &= ~(presence & tsMbOverrun);
+
+    return presence & ~tsMbOverrun;
+}
+
+char tsMbReadPower(char mask)
+{
+    char presence, parasite = 0;
+    int  retry = TS_OVERRUN_RETRY;
+
+    do
+    {
+        presence = tsMbMstRst(mask);
+
+        if(presence)
+        {
+            // parasite powered sensors pull the bus low during the read slot
+            tsMbWriteByte(presence, SKIP_ROM);
+            tsMbWriteByte(presence, READ_PSUPPLY);
+
+            parasite = ~tsMbReadBit(presence) & presence;
+        }
+    }
+    while((tsMbOverrun & presence) && retry--);
+
+    // the buses that took a slot as a reset every time are asked again next time
+    presence &= ~tsMbOverrun;
+
+    tsMbParasite    = (tsMbParasite & ~presence) | (parasite & presence);
+    tsMbPowerKnown |= presence;
+
+    return tsMbParasite & mask;
+}
+
+char tsMbWaitConvert(char mask, char config)
+{
+    char polled   = mask & ~tsMbParasite;
+    char parasite = mask &  tsMbParasite;
+    char late     = 0;
+    unsigned int ms, slots;
+
+    // the conversion time is rounded up to the next ms
+    ms = ((unsigned long)tsConvTicks(config) * 1000 + 32767) >> 15;
+
+    // the polled buses are given up after the TS_CONV_US deadline of the resolution
+    slots = TS_WAIT_BLOCKS((unsigned long)TS_CONV_US * (tsConvTicks(config) / TS_CONV_TICKS)) * TS_WAIT_BLOCK;
+
+/*  the externally powered buses drop out as soon as they return a 1, the
+    parasite powered ones can't be polled so they are only released once
+    their conversion time is over. The strong pull-ups aren't touched by the
+    read slots since only the polled buses are selected                       */
+
+    while(polled || parasite)
+    {
+        if(polled)
+        {
+            polled &= ~tsMbReadBit(polled);
+
+            if(polled && !--slots)
+            {
+                late   = polled;
+                polled = 0;
+            }
+        }
+
+        if(parasite)
+        {
+            if(ms)
+            {
+                __delay_cycles(TS_CYCLES(1000));
+                ms--;
+
+                // the ms spent here also counts against the deadline of the polled buses
+                if(polled)
+                {
+                    if(slots > TS_MB_MS_SLOTS)
+                        slots -= TS_MB_MS_SLOTS;
+                    else
+                    {
+                        late   = polled;
+                        polled = 0;
+                    }
+                }
+            }
+            else
+            {
+                TS_MB_SPU_OUT &= ~parasite;
+                parasite = 0;
+            }
+        }
+    }
+
+    return late;
+}
+
+char tsMbReadSPad(DS18B20* sensors, char mask)
+{
+    char presence, valid = 0;
+    int  bus, retry = TS_OVERRUN_RETRY;
+
+    do
+    {
+        presence = tsMbMstRst(mask);
+
+        if(presence)
+        {
+            // each bus gets the address of its own sensor
+            tsMbWriteByte(presence, MATCH_ROM);
+            tsMbWriteData(presence, sensors[0].addr, sizeof(DS18B20), 8);
+
+            tsMbWriteByte(presence, READ_SPAD);
+            tsMbReadData(presence, sensors[0].scrPad, sizeof(DS18B20), 9);
+        }
+    }
+    while((tsMbOverrun & presence) && retry--);
+
+    for(bus = 0; bus < TS_MB_BUSES; bus++)
+    {
+        if(!(mask & (1 << bus)))
+            continue;
+
+        if(!(presence & (1 << bus)))
+            sensors[bus].status = TS_ERR_PRESENCE;
+        else if(tsMbOverrun & (1 << bus))
+            sensors[bus].status = TS_ERR_OVERRUN;
+        else if(tsCalcCrc(sensors[bus].scrPad, 9))
+            sensors[bus].status = TS_ERR_CRC;
+        else
+        {
+            sensors[bus].temp   = tsSPadTemp(sensors[bus].scrPad);
+            sensors[bus].status = TS_OK;
+
+            valid |= 1 << bus;
+        }
+    }
+
+    return valid;
+}
+
+char tsMbReadTemp(DS18B20* sensors, char mask)
+{
+    char config = TS_9BITS;
+    char busy, late, lost, valid;
+    int  bus;
+
+    busy = tsMbConvertTemp(mask);
+    lost = mask & tsMbOverrun;
+
+    // the parasite powered buses wait for the slowest resolution
+    for(bus = 0; bus < TS_MB_BUSES; bus++)
+    {
+        if((busy & (1 << bus)) && tsConvTicks(sensors[bus].scrPad[TS_CONFIG]) > tsConvTicks(config))
+            config = sensors[bus].scrPad[TS_CONFIG];
+    }
+
+    late  = tsMbWaitConvert(busy, config);
+    valid = tsMbReadSPad(sensors, mask & ~late & ~lost);
+
+    // the buses still low after the deadline and the ones that never converted aren't read
+    for(bus = 0; bus < TS_MB_BUSES; bus++)
+    {
+        if(late & (1 << bus))
+            sensors[bus].status = TS_ERR_TIMEOUT;
+        else if(lost & (1 << bus))
+            sensors[bus].status = TS_ERR_OVERRUN;
+    }
+
+    return valid;
+}
@@ -0,0 +1,139 @@
+; Function:		tsMbSlots
+;
+; Author:		Gian Moreira
+;
+; Description:		. This function runs n 1-wire slots on up to 8 buses at the same time. Bus n is read from bit n of
+;			TS_MB_BUS and driven by bit n of TS_MB_OUT, so a single write starts the slot on every bus and a single
+;			read samples all of them
+;			. Every slot pulls the selected buses low, releases the ones that write a 1 (or start a read slot) after
+;			the wakeup pulse, samples the port and releases the rest once the 60us are over
+;			. Interrupts are only masked from the start of a slot until the buses are sampled, and around the
+;			release, the same way as in tsWriteByte. If an interrupt stretched a slot, the buses are checked for a
+;			presence pulse and the ones that took it as a reset are set in tsMbOverrun
+;			. Total slot time in clk cycles = 65 (at 1.048 MHz)
+;			. The strong pull-up of the spu buses is turned on right after they are released in the last slot, so
+;			the parasite powered sensors get it within a few cycles of a CONVERT_T
+;
+; Inputs:		slots	-	one byte per slot, bit n is the bit sent on bus n
+;			bitLen	-	amount of slots
+;			mask	-	buses to be used
+;			spu	-	buses whose strong pull-up is turned on at the end of the last slot
+;
+; Outputs:		the byte of each slot is overwritten with what the port read in that slot
+;
+; Return:		R12 is register used to pass in the address of the slots, and the register used to return a value for this
+; 			function. The bits of the buses that aren't in mask are whatever the port read, so they must be masked
+;------------------------------------------------------------------------------------------------------------------------------
+        	    .cdecls C,LIST,"msp430.h"   		 			; Include device header file
+        	    .cdecls C,LIST,"DS18B20.h"			   			; Include D1S8B20 header file
+;------------------------------------------------------------------------------------------------------------------------------
+; Register definitions
+;------------------------------------------------------------------------------------------------------------------------------
+        	    .define R12, slots							; R12 is the register with the address of the slots
+        	    .define R13, bitLen							; R13 is a passed in argument with the amount of slots
+        	    .define R14, mask							; R14 is a passed in argument with the buses to be used
+		    .define R15, spu							; R15 is a passed in argument with the strong pull-ups to turn on
+		    .define R10, int_ret_reg						; R10 keeps the value used to count the amount of iterations needed
+		    .define R11, ones							; R11 keeps the buses released early, it is a save-on-call register
+		    .define R9, gie							; R9 keeps the GIE bit of the caller
+;------------------------------------------------------------------------------------------------------------------------------
+; Define functions constants
+;------------------------------------------------------------------------------------------------------------------------------
+; the delay loop counter TS_CYCLE_DELAY_M and the paddings TS_PAD_LOW and TS_SAMPLE_LOOP are generated from TS_MCLK_HZ in
+; DS18B20.h. At 1.048 MHz: TS_CYCLE_DELAY_M = ([63 cycles] - [23 cycles] + [2 cycles to round up])/([3 cycles per iteration])
+SENTINEL		.equ	-1							; the PC pushed by an interrupt is always even, so it can't be -1
+;------------------------------------------------------------------------------------------------------------------------------
+; Code Section
+;------------------------------------------------------------------------------------------------------------------------------
+				.text
+				.global tsMbSlots					; declare tsMbSlots as global
+				.global tsMbOverrun					; buses that took a stretched slot as a reset, from ts_multi.c
+
+tsMbSlots:
+				push	slots						; save the contents inside R12
+				push	bitLen						; save the contents inside R13
+				push	int_ret_reg					; save the contents inside R10
+				push	gie						; save the contents inside R9
+
+				mov	SR, gie						; keep the interrupt state of the caller
+				and	#GIE, gie
+
+				tst	bitLen						; nothing to do if there are no slots
+				jz	return_back
+
+next_slot:			mov.b	@slots, ones					; [cycles: 2] get the buses that write a 1 in this slot
+				and.b	mask, ones					; [cycles: 1] never touch the buses that aren't selected
+				mov	#SENTINEL, -2(SP)				; [cycles: 4] an interrupt overwrites the word below the stack
+				dint							; [cycles: 1] mask the interrupts for the start of the slot
+				nop							; [cycles: 1] dint takes effect after the next instruction
+
+				bis.b	mask, &TS_MB_OUT				; [cycles: 4] pull every bus low to send a wakeup signal
+				.if	TS_PAD_LOW > 0
+				.loop	TS_PAD_LOW					; [cycles: TS_PAD_LOW] keep the buses low for at least 2us on fast clocks
+				nop
+				.endloop
+				.endif
+				bic.b	ones, &TS_MB_OUT				; [cycles: 4] release the buses that write a 1 or read
+
+; the buses are sampled about 11us after the falling edge at 1 MHz, and about 9us plus the time of the mov on faster clocks,
+; which is still within the 15us of a read slot
+
+				.if	TS_SAMPLE_LOOP > 0
+				mov	#TS_SAMPLE_LOOP, int_ret_reg			; [cycles: 2] on fast clocks, wait until about 9us after the falling edge
+sample_delay:			dec	int_ret_reg					; [cycles: 1] decrement interation register
+				jnz	sample_delay					; [cycles: 2] keep looping unitl interation register is 0
+				.endif
+
+				mov.b	&TS_MB_BUS, 0(slots)				; [cycles: 6] sample every bus at once
+				bis	gie, SR						; [cycles: 1] the rest of the slot can be interrupted
+
+				mov	#TS_CYCLE_DELAY_M, int_ret_reg			; [cycles: 2] move the number of delay cycles needed to delay
+
+delay_loop:			dec	int_ret_reg					; [cycles: 1] decrement interation register
+				jnz	delay_loop					; [cycles: 2] keep looping unitl interation register is 0
+
+recover:			dint							; [cycles: 1] mask the interrupts around the release
+				nop							; [cycles: 1] dint takes effect after the next instruction
+				bic.b	mask, &TS_MB_OUT				; [cycles: 4] release the buses that wrote a 0
+				cmp	#1, bitLen					; [cycles: 1] check whether this was the last slot
+				jne	check_slot					; [cycles: 2]
+				bis.b	spu, &TS_MB_SPU_OUT				; [cycles: 4] strong pull-up right after the release of the last slot
+
+check_slot:			cmp	#SENTINEL, -2(SP)				; [cycles: 3] check whether an interrupt stretched the slot
+				jne	check_reset					; [cycles: 2] look for a presence pulse if it did
+
+next_recover:			inc	slots						; [cycles: 1] move to the next slot
+				dec	bitLen						; [cycles: 1] decrement the amount of slots left
+				jnz	next_slot					; [cycles: 2] jump to the next slot
+
+return_back:			bis	gie, SR						; restore the interrupt state of the caller
+				pop	gie						; restore whatever was stored inside R9
+				pop	int_ret_reg					; restore whatever was stored inside R10
+				pop	bitLen						; restore whatever was stored inside R13
+				pop	slots						; return the address of the first slot
+
+				reta
+
+; the sensors answer a reset with a presence pulse 15us to 60us after the bus is released, so a bus still low after 60us means
+; the stretched slot was taken as a reset and the rest of the transaction is lost on that bus
+
+check_reset:			bis	gie, SR						; the caller's interrupts don't have to wait for the check
+				bic.b	spu, &TS_MB_SPU_OUT				; the strong pull-up would hide a presence pulse
+				mov	#TS_CYCLE_DELAY_W, int_ret_reg			; delay 60us
+
+reset_delay:			dec	int_ret_reg					; decrement interation register
+				jnz	reset_delay					; keep looping unitl interation register is 0
+
+				mov.b	&TS_MB_BUS, ones				; the selected buses that are still low answered a reset
+				inv.b	ones
+				and.b	mask, ones
+				bis.b	ones, &tsMbOverrun				; flag them so the transaction is run again
+
+				cmp	#1, bitLen					; the strong pull-up goes back on after the last slot
+				jne	next_recover
+				bis.b	spu, &TS_MB_SPU_OUT
+				jmp	next_recover
+
+				.end
+; recovery time:	 	21 cycles (apprx. 20.038us), min is 1us  (recover + check_slot + next_slot)
+; total write time:		65 cycles (apprx. 61.989us), min is 60us (bis + delay_loop + recover) at 1.048 MHz
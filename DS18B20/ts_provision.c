@@ -0,0 +1,124 @@
+/*
+ * ts_provision.c
+ *
+ * Batched provisioning of the alarm thresholds and resolution of every sensor on a bus
+ *
+ * The EEPROM of every sensor is recalled into its scratch pad first, so a sensor is only copied
+ * again when what it keeps in its EEPROM differs from the setup it should have. When every sensor
+ * on the bus has to change to the same setup, they are written and copied with a single SKIP_ROM
+ * broadcast, so the whole bus waits for a single copy instead of one per sensor.
+ */
+
+#include <msp430.h>
+#include "DS18B20.h"
+
+
+
+
+static const char tsScrRecall[] = {TS_OP_RESET, TS_OP_ROM, TS_OP_CMD, RECALL_E2, TS_OP_WAIT, TS_WAIT_BLOCKS(TS_COPY_US), TS_OP_END};
+
+
+
+
+static int tsSetupMatch(DS18B20* sensor, const DS18B20Setup* setup)
+{
+    return sensor->scrPad[TS_ALARM_HI] == setup->alarmHi &&
+           sensor->scrPad[TS_ALARM_LO] == setup->alarmLo &&
+           sensor->scrPad[TS_CONFIG]   == setup->config;
+}
+
+static int tsSetupSame(const DS18B20Setup* a, const DS18B20Setup* b)
+{
+    return a->alarmHi == b->alarmHi && a->alarmLo == b->alarmLo && a->config == b->config;
+}
+
+static void tsSetupKeep(DS18B20* sensor, const DS18B20Setup* setup)
+{
+    sensor->scrPad[TS_ALARM_HI] = setup->alarmHi;
+    sensor->scrPad[TS_ALARM_LO] = setup->alarmLo;
+    sensor->scrPad[TS_CONFIG]   = setup->config;
+}
+
+int tsProvision(DS18B20* sensors, const DS18B20Setup* setups, int n)
+{
+    DS18B20 bus;
+    int changed = 0;
+    int same    = 1;
+    int copied  = 0;
+    int status;
+    int i;
+
+    // load the EEPROM of every sensor into its scratch pad, so the comparison sees what a reboot would
+    if(tsRunScript(tsScrRecall, 0, 0))
+        return -1;
+
+    for(i = 0; i < n; i++)
+    {
+        if(!tsSetupSame(&setups[i], &setups[0]))
+            same = 0;
+
+        sensors[i].status = tsReadSPadAs(&sensors[i], TS_PROFILE_VERIFIED);
+
+        // a sensor that can't be read is left alone
+        if(sensors[i].status == TS_OK && !tsSetupMatch(&sensors[i], &setups[i]))
+        {
+            sensors[i].status = TS_PROV_CHANGED;
+            changed++;
+        }
+    }
+
+    if(!changed)
+        return 0;
+
+/*  the changed sensors sharing a setup are only broadcast when they are every
+    sensor on the bus, a broadcast COPY_SPAD would also rewrite the EEPROM of
+    the sensors that already matched or keep another setup. A single sensor to
+    copy is cheaper to address on its own                                       */
+
+    if(same && changed == n && changed > 1)
+    {
+        status = tsWriteSpad_sS(&bus, setups[0].alarmHi, setups[0].alarmLo, setups[0].config);
+
+        if(status == TS_OK)
+            status = tsCopySpad_sS(&bus);
+
+        if(status != TS_OK)
+        {
+            for(i = 0; i < n; i++)
+            {
+                if(sensors[i].status == TS_PROV_CHANGED)
+                    sensors[i].status = status;
+            }
+
+            return -1;
+        }
+
+        for(i = 0; i < n; i++)
+        {
+            if(sensors[i].status == TS_PROV_CHANGED)
+            {
+                tsSetupKeep(&sensors[i], &setups[0]);
+                sensors[i].status = TS_OK;
+                copied++;
+            }
+        }
+
+        return copied;
+    }
+
+    for(i = 0; i < n; i++)
+    {
+        if(sensors[i].status != TS_PROV_CHANGED)
+            continue;
+
+        sensors[i].status = tsWriteSpad(&sensors[i], setups[i].alarmHi, setups[i].alarmLo, setups[i].config);
+
+        if(sensors[i].status == TS_OK)
+            sensors[i].status = tsCopySpad(&sensors[i]);
+
+        if(sensors[i].status == TS_OK)
+            copied++;
+    }
+
+    return copied;
+}
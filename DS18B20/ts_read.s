@@ -11,6 +11,11 @@
 ; Return:		R12 is register used to pass in the address of the buffer, and the register used to return a value for this
 ; 			function, so if this function fails, it wil return an unpredictable value; however, I haven't encountered any
 ; 			error so far
+; 			. tsReadDataCrc reads the bytes the same way, but returns the CRC-8 of the bytes read instead, which is 0 if the
+; 			last byte read was a valid CRC. The CRC is updated inside the delay of each read slot, so it is ready as soon as
+; 			the last bit arrives without adding any time to the transfer
+; 			. Interrupts are only masked from the start of each slot until the bus is sampled, the interrupt state of the
+; 			caller is restored for the CRC update and the rest of the slot, where an interrupt only stretches the recovery
 ;------------------------------------------------------------------------------------------------------------------------------
         	    .cdecls C,LIST,"msp430.h"   		 			; Include device header file
         	    .cdecls C,LIST,"DS18B20.h"			   			; Include D1S8B20 header file
@@ -21,46 +26,94 @@
         	    .define R13, bufLen							; R13 is a passed in argument with the size of the buffer
         	    .define R14, oneByteReg						; R14 holds the number of iterations needed
 		    .define R15, int_ret_reg						; R15 keeps the value used to count the amount of iterations needed
+		    .define R11, crc							; R11 keeps the CRC, it is a save-on-call register so it isn't saved
+		    .define R10, gie							; R10 keeps the GIE bit of the caller
 ;------------------------------------------------------------------------------------------------------------------------------
 ; Define functions constants
 ;------------------------------------------------------------------------------------------------------------------------------
 ONE_BYTE 		.equ	8							; 8-bits
-CYCLE_DELAY		.equ	11							; CYCLE_DELAY = ([63 cycles] - [30 cycles])/([3 cycles per iteration])
+; the delay loop counter TS_CYCLE_DELAY_R and the paddings TS_PAD_LOW and TS_SAMPLE_LOOP are generated from TS_MCLK_HZ in
+; DS18B20.h. At 1.048 MHz: TS_CYCLE_DELAY_R = ([63 cycles] - [42 cycles])/([3 cycles per iteration]) and there is no padding
+CRC_POLY		.equ	0x8C							; x^8 + x^5 + x^4 + 1 shifted lsb first
 ;------------------------------------------------------------------------------------------------------------------------------
 ; Code Section
 ;------------------------------------------------------------------------------------------------------------------------------
+				.if	TS_BACKEND == TS_BACKEND_ASM			; only assembled when the assembly backend is selected
+
 				.text
 				.global tsReadData					; declare tsWriteByte as global
+				.global tsReadDataCrc					; declare tsReadDataCrc as global
+
+tsReadDataCrc:
+				calla	#tsReadData					; read the data, the CRC is left in R11
+				mov.b	crc, byte					; return the CRC instead of the address
+				reta
 
 tsReadData:
 				push	byte						; save the contents inside R12
 				push	bufLen						; save the contents inside R13
 				push	oneByteReg					; save the contents inside R14
 				push	int_ret_reg					; save the contents inside R15
+				push	gie						; save the contents inside R10
+
+				mov	SR, gie						; keep the interrupt state of the caller
+				and	#GIE, gie
+
+				clr	crc						; start the CRC from 0
 
 next_cycle:			mov.b	#ONE_BYTE, oneByteReg				; [cycles: 2] move one byte to R13 to keep track of the number of iterations
 
 read_data:			rra.b	0(byte)						; [cycles: 4] shift the contents to the right since data is lsb first
+				dint							; [cycles: 1] mask the interrupts until the bus is sampled
+				nop							; [cycles: 1] dint takes effect after the next instruction
 				bis.b	#TS_OUTBIT, &TS_OUT				; [cycles: 4] pull the bus low to send a wakeup signal
+				.if	TS_PAD_LOW > 0
+				.loop	TS_PAD_LOW					; [cycles: TS_PAD_LOW] keep the bus low for at least 2us on fast clocks
+				nop
+				.endloop
+				.endif
 				bic.b	#TS_OUTBIT, &TS_OUT				; [cycles: 4] release the bus
 
 ; since the toggle takes more than 8 cycles, it is okay to read right after the falling edge pusle, but since this could be in
 ; a high capacitance system, we will add 2 extra cycles, which is about 1.9us to allow the signal to be stable
 ; the signal should be read within 15us after the falling edge, which translates to less than 15 cycles for the msp430f5529
 
-				mov.b	#TS_CYCLE_DELAY_R, int_ret_reg			; [cycles: 2] move the number of delay cycles needed to delay
+				.if	TS_SAMPLE_LOOP > 0
+				mov	#TS_SAMPLE_LOOP, int_ret_reg			; [cycles: 2] on fast clocks, wait until about 9us after the falling edge
+sample_delay:			dec	int_ret_reg					; [cycles: 1] decrement interation register
+				jnz	sample_delay					; [cycles: 2] keep looping unitl interation register is 0
+				.endif
+
+				mov	#TS_CYCLE_DELAY_R, int_ret_reg			; [cycles: 2] move the number of delay cycles needed to delay
 
 				bit.b	#TS_INBIT, &TS_BUS				; [cycles: 3] check the status of the bus
 				jnz	read_H						; [cycles: 2] if the comparisson returns a 0, read the signal as a low
 
 read_L:				bic.b	#BIT7, 0(byte)					; [cycles: 5] set msb low if the input data is a '0'
 				nop							; [cycles: 1] add an extra cycle to match read_H
-				jmp	delay_loop					; [cycles: 2] jump to delay loop
+				jmp	crc_update					; [cycles: 2] jump to update the CRC
 
 
 read_H:				bis.b	#BIT7, 0(byte)					; [cycles: 5] set the msb high if the input data is a '1'
-				nop							; [cycles: 1] add an extra cycle to match read_H
-				nop							; [cycles: 1] add an extra cycle to match read_H
+				xor.b	#1, crc						; [cycles: 1] feed the '1' into the CRC
+				nop							; [cycles: 1] add an extra cycle to match read_L
+				nop							; [cycles: 1] add an extra cycle to match read_L
+
+; the CRC is updated in the time the bus would otherwise spend in the delay loop. The feedback bit is the lsb of the CRC xored
+; with the bit read, so once it's shifted into the carry the polynomial is applied if it was a '1'. Both paths take 9 cycles
+
+crc_update:			bis	gie, SR						; [cycles: 1] the rest of the slot can be interrupted
+				clrc							; [cycles: 1] shift a 0 into the msb of the CRC
+				rrc.b	crc						; [cycles: 1] shift the feedback bit into the carry
+				jc	crc_xor						; [cycles: 2] apply the polynomial if the feedback was a '1'
+				nop							; [cycles: 1] add an extra cycle to match crc_xor
+				nop							; [cycles: 1] add an extra cycle to match crc_xor
+				nop							; [cycles: 1] add an extra cycle to match crc_xor
+				jmp	delay_loop					; [cycles: 2] jump to delay loop
+
+crc_xor:			xor.b	#CRC_POLY, crc					; [cycles: 2] apply the polynomial
+				nop							; [cycles: 1] add an extra cycle to match crc_update
+				nop							; [cycles: 1] add an extra cycle to match crc_update
 				nop							; [cycles: 1] add an extra cycle to make delay cycles a multiple of 3
 
 delay_loop:			dec	int_ret_reg					; [cycles: 1] decrement interation register
@@ -73,6 +126,7 @@ prepare_next:			inc	byte						; [cycles: 1] increment cycle to store the next by
 				dec	bufLen						; [cycles: 1] decrement the length of the buffer until it reads 0
 				jnz	next_cycle					; [cycles: 2] jump to get the next data
 
+				pop	gie						; restore whatever was stored inside R10
 				pop	int_ret_reg					; restore whatever was stored inside R15
 				pop	oneByteReg					; restore whatever was stored inside R14
 				pop	bufLen						; restore whatever was stored inside R13
@@ -82,6 +136,8 @@ prepare_next:			inc	byte						; [cycles: 1] increment cycle to store the next by
 
 				reta
 
+				.endif
+
 				.end
 
 
@@ -5,44 +5,60 @@
 ;------------------------------------------------------------------------------------------------------------------------------
         	    .define R12, return					; R12 is also the register with the address of the keypad data
         	    .define R13, int_ret_reg				; R13 keeps the value used to count the amount of iterations needed
+        	    .define R14, gie					; R14 keeps the GIE bit of the caller, it is a save-on-call register
 ;------------------------------------------------------------------------------------------------------------------------------
 ; Define functions constants
 ;------------------------------------------------------------------------------------------------------------------------------
-CYCLE_DELAY		.equ	17
+; the delay loop counter TS_CYCLE_DELAY_RB and the paddings TS_PAD_LOW and TS_SAMPLE_LOOP are generated from TS_MCLK_HZ in
+; DS18B20.h. At 1.048 MHz: TS_CYCLE_DELAY_RB = ([63 cycles] - [22 cycles])/([3 cycles per iteration]) and there is no padding
+; interrupts are only masked from the start of the slot until the bus is sampled
 ;------------------------------------------------------------------------------------------------------------------------------
 ; Code Section
 ;------------------------------------------------------------------------------------------------------------------------------
+				.if	TS_BACKEND == TS_BACKEND_ASM		; only assembled when the assembly backend is selected
+
 				.text
 				.global tsReadBit						; declare tsWriteByte as global
 
 tsReadBit:
 				push	int_ret_reg						; save the contents of R13
-				mov	#CYCLE_DELAY, int_ret_reg				; set the amount of cycles needed to be delayed for one bit transfer
 
+				mov	SR, gie							; keep the interrupt state of the caller
+				and	#GIE, gie
+				dint								; mask the interrupts until the bus is sampled
+				nop								; dint takes effect after the next instruction
 
 				bis.b	#TS_OUTBIT, &TS_OUT					; [cycles: 4] pull the bus low to send a wakeup signal
+				.if	TS_PAD_LOW > 0
+				.loop	TS_PAD_LOW						; [cycles: TS_PAD_LOW] keep the bus low for at least 2us on fast clocks
+				nop
+				.endloop
+				.endif
 				bic.b	#TS_OUTBIT, &TS_OUT					; [cycles: 4] release the bus
 
 				nop								; [cycles: 1] delay one cycle to alow the bus to be stable
 				nop								; [cycles: 1] delay another cycle allow the bus to stabilize
+
+				.if	TS_SAMPLE_LOOP > 0
+				mov	#TS_SAMPLE_LOOP, int_ret_reg				; [cycles: 2] on fast clocks, wait until about 9us after the falling edge
+sample_delay:			dec	int_ret_reg						; [cycles: 1] decrement interation register
+				jnz	sample_delay						; [cycles: 2] keep delaying until count = 0
+				.endif
 	
 				bit.b	#TS_INBIT, &TS_BUS					; [cycles: 3] check if the bus was high or low
 				jnz	read_H							; [cycles: 2] if the 0 flag isn't up, bus was high
 
 read_L:				clr	return							; [cycles: 1] return a 0 if the bus was low
-
-				nop								; [cycles: 1] delay by 2 cycles to make the number of cycles a multiple of 63
-				nop								; [cycles: 1] delay by 2 cycles to make the number of cycles a multiple of 63
-
-				jmp	delay_loop						; [cycles: 2] delay the period of a bit
+				nop								; [cycles: 1] delay one cycle to match read_H
+				jmp	load_delay						; [cycles: 2] delay the period of a bit
 
 read_H:				mov	#1, return						; [cycles: 1] return a 1 if the bus was high
 				nop								; [cycles: 1] delay one cycle to match read_L
 				nop								; [cycles: 1] delay one cycle to match read_L
+				nop								; [cycles: 1] delay one cycle to match read_L
 
-				nop								; [cycles: 1] delay by 2 cycles to make the number of cycles a multiple of 63
-				nop								; [cycles: 1] delay by 2 cycles to make the number of cycles a multiple of 63
-
+load_delay:			bis	gie, SR							; [cycles: 1] the rest of the slot can be interrupted
+				mov	#TS_CYCLE_DELAY_RB, int_ret_reg				; [cycles: 2] set the amount of cycles needed to be delayed for one bit transfer
 
 delay_loop:			dec	int_ret_reg						; [cycles: 1] decrement interation register
 				jnz	delay_loop						; [cycles: 2] keep delaying until count = 0
@@ -50,3 +66,5 @@ delay_loop:			dec	int_ret_reg						; [cycles: 1] decrement interation register
 				pop	int_ret_reg						; restore R13
 
 				reta
+
+				.endif
@@ -0,0 +1,295 @@
+/*
+ * ts_registry.c
+ *
+ * ROM code registry kept in information memory
+ *
+ * The sensors found on the last boot are saved with their bus, resolution and alarm thresholds, so
+ * a reboot only has to ping the known ROM codes with MATCH_ROM instead of searching every bus again.
+ * A bus is only searched again when one of its sensors is missing.
+ */
+
+#include <msp430.h>
+#include "DS18B20.h"
+
+
+
+
+static DS18B20Registry* tsRegSegment(int index)
+{
+    return (DS18B20Registry*)(TS_REG_BASE + index * TS_REG_SEG_SIZE);
+}
+
+static const DS18B20Registry* tsRegFind(int* index)
+{
+    const DS18B20Registry* reg;
+    const DS18B20Registry* newest = 0;
+    int i;
+
+    for(i = 0; i < TS_REG_SEGMENTS; i++)
+    {
+        reg = tsRegSegment(i);
+
+        // an erased segment or a save that was cut short still has its sequence number erased
+        if(reg->seq == 0xFFFF || reg->count > TS_REG_ENTRIES)
+            continue;
+
+        if(tsCalcCrc((char*)&reg->count, 1 + reg->count * sizeof(DS18B20Entry)) != reg->crc)
+            continue;
+
+        // the sequence number wraps around, so the newest copy is the one ahead of the others
+        if(!newest || (int)(reg->seq - newest->seq) > 0)
+        {
+            newest = reg;
+            *index = i;
+        }
+    }
+
+    return newest;
+}
+
+static int tsRegWrite(DS18B20Registry* dst, DS18B20Registry* src)
+{
+    volatile char* to = (volatile char*)dst;
+    char* from = (char*)src;
+    unsigned int gie = __get_SR_register() & GIE;
+    unsigned int i;
+
+    __disable_interrupt();
+
+    FCTL3 = FWKEY;                  // unlock the flash
+    FCTL1 = FWKEY|ERASE;
+    *to   = 0;                      // dummy write to erase the segment
+
+    FCTL1 = FWKEY|WRT;
+
+    // the sequence number is written last, so the copy is only valid once it is complete
+    for(i = sizeof(dst->seq); i < sizeof(DS18B20Registry); i++)
+        to[i] = from[i];
+
+    *(volatile unsigned int*)&dst->seq = src->seq;
+
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY|LOCK;             // lock the flash again
+
+    __bis_SR_register(gie);
+
+    for(i = 0; i < sizeof(DS18B20Registry); i++)
+    {
+        if(to[i] != from[i])
+            return -1;
+    }
+
+    return 0;
+}
+
+static int tsRegPing(DS18B20* sensor, char bus)
+{
+    char mask = 1 << bus;
+    int  status;
+
+    // a sensor is only there if it answers its ROM code with a valid scratch pad
+    if(bus == TS_REG_MAIN_BUS)
+    {
+        status = tsReadSPadAddr(sensor->addr, sensor->scrPad);
+
+        if(status)
+            return status;
+    }
+    else
+    {
+        int retry = TS_OVERRUN_RETRY;
+
+        do
+        {
+            if(!tsMbMstRst(mask))
+                return TS_ERR_PRESENCE;
+
+            // with a single bus selected the stride is never used
+            tsMbWriteByte(mask, MATCH_ROM);
+            tsMbWriteData(mask, sensor->addr, 0, 8);
+            tsMbWriteByte(mask, READ_SPAD);
+            tsMbReadData(mask, sensor->scrPad, 0, 9);
+        }
+        while((tsMbOverrun & mask) && retry--);
+
+        if(tsMbOverrun & mask)
+            return TS_ERR_OVERRUN;
+
+        if(tsCalcCrc(sensor->scrPad, 9))
+            return TS_ERR_CRC;
+    }
+
+    sensor->temp = tsSPadTemp(sensor->scrPad);
+
+    return TS_OK;
+}
+
+static int tsRegGetAddrMb(DS18B20* sensor, char bus)
+{
+    char mask = 1 << bus;
+    int  retry = TS_OVERRUN_RETRY;
+
+    do
+    {
+        if(!tsMbMstRst(mask))
+            return -1;
+
+        tsMbWriteByte(mask, READ_ROM);
+        tsMbReadData(mask, sensor->addr, 0, 8);
+    }
+    while((tsMbOverrun & mask) && retry--);
+
+    if(tsMbOverrun & mask)
+        return -1;
+
+    // a shorted bus reads an all 0 ROM code and scratch pad, both pass the CRC
+    return tsAddrValid(sensor->addr) ? 0 : -1;
+}
+
+
+
+
+const DS18B20Registry* tsRegLoad()
+{
+    int index;
+
+    return tsRegFind(&index);
+}
+
+int tsRegSave(DS18B20* sensors, char* buses, int n)
+{
+    DS18B20Registry reg;
+    const DS18B20Registry* last;
+    int index = 0;
+    int i, j;
+    unsigned int k;
+
+    if(n > TS_REG_ENTRIES)
+        n = TS_REG_ENTRIES;
+
+    reg.count = n;
+
+    for(i = 0; i < n; i++)
+    {
+        for(j = 0; j < 6; j++)
+            reg.entries[i].serial[j] = sensors[i].addr[j + 1];
+
+        reg.entries[i].bus     = buses[i];
+        reg.entries[i].config  = sensors[i].scrPad[TS_CONFIG];
+        reg.entries[i].alarmHi = sensors[i].scrPad[TS_ALARM_HI];
+        reg.entries[i].alarmLo = sensors[i].scrPad[TS_ALARM_LO];
+    }
+
+    reg.crc = tsCalcCrc(&reg.count, 1 + n * sizeof(DS18B20Entry));
+
+    last = tsRegFind(&index);
+
+    // nothing changed, so the flash isn't touched
+    if(last && last->count == reg.count && last->crc == reg.crc)
+    {
+        for(k = 0; k < n * sizeof(DS18B20Entry); k++)
+        {
+            if(((const char*)last->entries)[k] != ((char*)reg.entries)[k])
+                break;
+        }
+
+        if(k == n * sizeof(DS18B20Entry))
+            return 0;
+    }
+
+    // the new copy goes to the next segment, 0xFFFF is skipped since it marks an erased segment
+    reg.seq = last ? last->seq + 1 : 0;
+
+    if(reg.seq == 0xFFFF)
+        reg.seq = 0;
+
+    return tsRegWrite(tsRegSegment(last ? (index + 1) % TS_REG_SEGMENTS : 0), &reg);
+}
+
+int tsRegBoot(DS18B20* sensors, char* buses, int maxSensors, char mbMask)
+{
+    const DS18B20Registry* reg = tsRegLoad();
+    unsigned int known   = 0;       // bit n is set for bus n, the main bus is bit TS_REG_MAIN_BUS
+    unsigned int missing = 0;
+    int found = 0;
+    int i, j, n;
+    char bus;
+
+    // ping every sensor of the last boot
+    for(i = 0; reg && i < reg->count && found < maxSensors; i++)
+    {
+        bus = reg->entries[i].bus;
+
+        if(bus < 0 || bus > TS_REG_MAIN_BUS)
+            continue;
+
+        known |= 1 << bus;
+
+        tsSerialAddr(sensors[found].addr, reg->entries[i].serial);
+
+        sensors[found].status = tsRegPing(&sensors[found], bus);
+
+        if(sensors[found].status == TS_OK)
+            buses[found++] = bus;
+        else
+            missing |= 1 << bus;
+    }
+
+    // an empty registry searches every bus, otherwise only the new buses are searched
+    if(!reg)
+        missing = (1 << TS_REG_MAIN_BUS) | (unsigned char)mbMask;
+    else
+        missing |= (unsigned char)mbMask & ~known;
+
+    if(!missing)
+        return found;
+
+    // the sensors of the buses searched again are dropped, the search finds them again
+    for(i = j = 0; i < found; i++)
+    {
+        if(missing & (1 << buses[i]))
+            continue;
+
+        sensors[j] = sensors[i];
+        buses[j++] = buses[i];
+    }
+
+    found = j;
+
+    if(missing & (1 << TS_REG_MAIN_BUS))
+    {
+        n = tsSearchRom(&sensors[found], maxSensors - found);
+
+        // the scratch pads are read to get the settings saved with the ROM codes
+        for(i = found; i < found + n; i++)
+        {
+            sensors[i].status = tsRegPing(&sensors[i], TS_REG_MAIN_BUS);
+
+            if(sensors[i].status != TS_OK)
+                continue;
+
+            sensors[j] = sensors[i];
+            buses[j++] = TS_REG_MAIN_BUS;
+        }
+
+        found = j;
+    }
+
+    for(bus = 0; bus < TS_MB_BUSES && found < maxSensors; bus++)
+    {
+        if(!(missing & (1 << bus)))
+            continue;
+
+        if(tsRegGetAddrMb(&sensors[found], bus))
+            continue;
+
+        sensors[found].status = tsRegPing(&sensors[found], bus);
+
+        if(sensors[found].status == TS_OK)
+            buses[found++] = bus;
+    }
+
+    tsRegSave(sensors, buses, found);
+
+    return found;
+}
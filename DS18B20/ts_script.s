@@ -0,0 +1,203 @@
+; Function:		tsRunScript
+;
+; Author:		Gian Moreira
+;
+; Description:		. This function runs a whole 1-wire transaction from a script, so the bytes of a transaction are sent
+;			back to back without going through C between them
+;			. A script is a list of opcodes (TS_OP_* in DS18B20.h) ended by TS_OP_END, some of them followed by an
+;			argument byte. It is run from the first opcode until TS_OP_END or until a reset isn't answered, a
+;			CRC fails or a wait reaches its deadline
+;			. The bit engine sets tsOverrun when an interrupt stretched a slot into a reset, then the script is run
+;			again from its first opcode, up to TS_OVERRUN_RETRY times
+;
+; Inputs:		script	-	the script to be run
+;			addr	-	ROM code used by TS_OP_ROM (a 0 uses SKIP_ROM instead) and filled by TS_OP_LOAD_ADDR
+;			buf	-	buffer used by TS_OP_WRITE and TS_OP_READ, each of them moves it forward
+;
+; Outputs:		the bytes read are stored in buf, and in addr for TS_OP_LOAD_ADDR
+;
+; Return:		R12 returns TS_OK if the whole script ran, TS_ERR_PRESENCE if a reset wasn't answered and TS_ERR_CRC if
+;			the bytes of a TS_OP_READ_CRC failed the CRC and TS_ERR_TIMEOUT if the bus was still low at the end of a
+;			TS_OP_WAIT. TS_ERR_OVERRUN is returned if the last run was also broken by an interrupt
+;------------------------------------------------------------------------------------------------------------------------------
+        	    .cdecls C,LIST,"msp430.h"   		 			; Include device header file
+        	    .cdecls C,LIST,"DS18B20.h"			   			; Include D1S8B20 header file
+;------------------------------------------------------------------------------------------------------------------------------
+; Register definitions
+;------------------------------------------------------------------------------------------------------------------------------
+        	    .define R12, arg							; R12 passes the arguments to the bit engine and gets its return
+        	    .define R13, len							; R13 passes the length to tsReadData
+        	    .define R10, script							; R10 points to the next opcode, it is a save-on-entry register
+        	    .define R9, addr							; R9 keeps the ROM code
+        	    .define R8, buf							; R8 points to the next byte of the buffer
+        	    .define R7, count							; R7 counts the bytes left in a write
+        	    .define R6, ptr							; R6 points to the next byte of the ROM code
+;------------------------------------------------------------------------------------------------------------------------------
+; Define functions constants
+;------------------------------------------------------------------------------------------------------------------------------
+ROM_LEN			.equ	8							; bytes in a ROM code
+;------------------------------------------------------------------------------------------------------------------------------
+; Code Section
+;------------------------------------------------------------------------------------------------------------------------------
+				.if	TS_BACKEND == TS_BACKEND_ASM			; only assembled when the assembly backend is selected
+
+				.text
+				.global tsRunScript					; declare tsRunScript as global
+				.global tsSpuMask					; strong pull-up bit of a parasite powered bus, from DS18B20.c
+				.global tsOverrun					; set by the bit engine when a slot was taken as a reset, from DS18B20.c
+
+tsRunScript:
+				push	script						; save the registers the C compiler expects to be preserved
+				push	addr
+				push	buf
+				push	count
+				push	ptr
+
+				mov	R12, script					; the script
+				mov	R13, addr					; the ROM code
+				mov	R14, buf					; the buffer
+
+				push	R12						; 4(SP) keeps the first opcode and 2(SP) the buffer to run the script
+				push	R14						; again, 0(SP) counts the runs left
+				push	#TS_OVERRUN_RETRY
+				clr.b	&tsOverrun
+
+next_op:			tst.b	&tsOverrun					; an interrupt broke the last opcode
+				jnz	overrun
+
+				mov.b	@script+, arg					; get the next opcode
+
+				cmp.b	#TS_OP_RESET, arg
+				jeq	op_reset
+				cmp.b	#TS_OP_CMD, arg
+				jeq	op_cmd
+				cmp.b	#TS_OP_ROM, arg
+				jeq	op_rom
+				cmp.b	#TS_OP_WRITE, arg
+				jeq	op_write
+				cmp.b	#TS_OP_READ, arg
+				jeq	op_read
+				cmp.b	#TS_OP_READ_CRC, arg
+				jeq	op_read_crc
+				cmp.b	#TS_OP_WAIT, arg
+				jeq	op_wait
+				cmp.b	#TS_OP_STRONG, arg
+				jeq	op_strong
+				cmp.b	#TS_OP_LOAD_ADDR, arg
+				jeq	op_load_addr
+				cmp.b	#TS_OP_ABORT, arg
+				jeq	op_abort
+
+op_end:				mov	#TS_OK, arg					; TS_OP_END (or an unknown opcode) ends the script
+				jmp	return_back
+
+op_reset:			calla	#tsMstRst					; reset the bus
+				tst	arg						; a 0 means a sensor answered
+				jz	next_op
+				mov	#TS_ERR_PRESENCE, arg
+				jmp	return_back
+
+op_abort:			calla	#tsMstRst					; reset the bus to abort a read, nobody has to answer
+				jmp	next_op
+
+op_cmd:				mov.b	@script+, arg					; the byte to be sent follows the opcode
+				cmp.b	#TS_OP_STRONG, 0(script)			; a strong pull-up right after the command is turned on by the
+				jeq	cmd_strong					; byte writer itself, within a few cycles of the last slot
+				calla	#tsWriteByte
+				jmp	next_op
+
+cmd_strong:			inc	script						; skip the TS_OP_STRONG
+				mov.b	&tsSpuMask, R13
+				calla	#tsWriteByteStrong
+				jmp	next_op
+
+op_rom:				tst	addr						; without a ROM code every sensor is selected
+				jnz	match_rom
+				mov.b	#SKIP_ROM, arg
+				calla	#tsWriteByte
+				jmp	next_op
+
+match_rom:			mov.b	#MATCH_ROM, arg
+				calla	#tsWriteByte
+				mov	addr, ptr					; the ROM code is sent from its first byte
+				mov	#ROM_LEN, count
+
+match_loop:			mov.b	@ptr+, arg					; send the next byte of the ROM code
+				calla	#tsWriteByte
+				dec	count
+				jnz	match_loop
+				jmp	next_op
+
+op_write:			mov.b	@script+, count					; the amount of bytes follows the opcode
+				tst	count
+				jz	next_op
+
+write_loop:			mov.b	@buf+, arg					; send the next byte of the buffer
+				calla	#tsWriteByte
+				dec	count
+				jnz	write_loop
+				jmp	next_op
+
+op_read:			mov.b	@script+, len					; the amount of bytes follows the opcode
+				mov	buf, arg
+				add	len, buf					; the buffer moves past the bytes read
+				calla	#tsReadData
+				jmp	next_op
+
+op_read_crc:			mov.b	@script+, len					; the amount of bytes follows the opcode
+				mov	buf, arg
+				add	len, buf					; the buffer moves past the bytes read
+				calla	#tsReadDataCrc
+				tst.b	arg						; the CRC of valid bytes is 0
+				jz	next_op
+				mov	#TS_ERR_CRC, arg
+				jmp	return_back
+
+op_wait:			mov.b	@script+, count					; the amount of blocks of slots follows the opcode
+				tst	count
+				jz	wait_timeout
+
+wait_block:			mov	#TS_WAIT_BLOCK, ptr				; read slots in the block
+
+wait_loop:			calla	#tsReadBit					; the bus returns a 1 once the sensors are done
+				tst	arg
+				jnz	next_op
+				dec	ptr
+				jnz	wait_loop
+				dec	count
+				jnz	wait_block
+
+wait_timeout:			mov	#TS_ERR_TIMEOUT, arg				; the bus was still low at the deadline
+				jmp	return_back
+
+op_strong:			bis.b	&tsSpuMask, &TS_SPU_OUT				; [cycles: 6] strong pull-up on parasite buses, when it doesn't follow a TS_OP_CMD
+				jmp	next_op
+
+op_load_addr:			mov	addr, arg					; read a ROM code into addr
+				mov	#ROM_LEN, len
+				calla	#tsReadData
+				jmp	next_op
+
+overrun:			clr.b	&tsOverrun
+				tst	0(SP)						; give up once every run was broken
+				jz	overrun_fail
+				dec	0(SP)
+				mov	4(SP), script					; run the script again from the start
+				mov	2(SP), buf
+				jmp	next_op
+
+overrun_fail:			mov	#TS_ERR_OVERRUN, arg
+				jmp	return_back
+
+return_back:			add	#6, SP						; drop the first opcode, the buffer and the run count
+				pop	ptr						; restore the save-on-entry registers
+				pop	count
+				pop	buf
+				pop	addr
+				pop	script
+
+				reta
+
+				.endif
+
+				.end
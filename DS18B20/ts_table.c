@@ -0,0 +1,131 @@
+/*
+ * ts_table.c
+ *
+ * Compact sensor table for buses with hundreds of sensors
+ *
+ * Only the serial of each ROM code is kept, the family code and the CRC are rebuilt when the
+ * sensor is addressed. The scratch pad is read into a buffer on the stack and only the temperature,
+ * resolution and status are kept, so a sensor takes 9 bytes of RAM.
+ */
+
+#include <msp430.h>
+#include "DS18B20.h"
+
+
+
+
+void tsTableInit(DS18B20Table* table)
+{
+    table->count = 0;
+}
+
+int tsTableAdd(DS18B20Table* table, char* addr)
+{
+    int index = table->count;
+    int i;
+
+    if(index >= TS_TABLE_SIZE || addr[0] != TS_FAMILY_CODE || tsCalcCrc(addr, 8))
+        return -1;
+
+    for(i = 0; i < 6; i++)
+        table->serial[index][i] = addr[i + 1];
+
+    table->temp[index]  = 0;
+    table->state[index] = TS_STATE(TS_OK, TS_12BITS);
+
+    table->count++;
+
+    return index;
+}
+
+void tsTableAddr(DS18B20Table* table, int index, char* addr)
+{
+    tsSerialAddr(addr, table->serial[index]);
+}
+
+int tsTableSearch(DS18B20Table* table)
+{
+    DS18B20Search search;
+    int added = 0;
+
+    tsSearchInit(&search);
+
+    while(table->count < TS_TABLE_SIZE)
+    {
+        if(tsSearchNextRetry(&search))
+            break;
+
+        if(tsTableAdd(table, search.addr) >= 0)
+            added++;
+    }
+
+    return added;
+}
+
+
+
+
+
+
+
+
+int tsTableRead(DS18B20Table* table, int index)
+{
+    char addr[8];
+    char scrPad[9];
+    int  status;
+
+    tsTableAddr(table, index, addr);
+
+    status = tsReadSPadAddr(addr, scrPad);
+
+    // the temperature and resolution are only updated by a valid scratch pad
+    if(status == TS_OK)
+    {
+        table->temp[index]  = tsSPadTemp(scrPad);
+        table->state[index] = TS_STATE(TS_OK, scrPad[TS_CONFIG]);
+    }
+    else
+        table->state[index] = TS_STATE(status, TS_STATE_GET_CONFIG(table->state[index]));
+
+    return status;
+}
+
+int tsTableReadAll(DS18B20Table* table)
+{
+    char res   = 0;
+    int  valid = 0;
+    int  i;
+
+    if(tsConvertTemp())
+    {
+        for(i = 0; i < table->count; i++)
+            table->state[i] = TS_STATE(TS_ERR_PRESENCE, TS_STATE_GET_CONFIG(table->state[i]));
+
+        return -1;
+    }
+
+    // a parasite powered bus waits for the slowest resolution
+    for(i = 0; i < table->count; i++)
+    {
+        if((table->state[i] & TS_STATE_RES) > res)
+            res = table->state[i] & TS_STATE_RES;
+    }
+
+    // a sensor holding the bus low makes every scratch pad on it meaningless
+    if(tsWaitConvert(TS_STATE_GET_CONFIG(res)))
+    {
+        for(i = 0; i < table->count; i++)
+            table->state[i] = TS_STATE(TS_ERR_TIMEOUT, TS_STATE_GET_CONFIG(table->state[i]));
+
+        return -1;
+    }
+
+    for(i = 0; i < table->count; i++)
+    {
+        if(tsTableRead(table, i) == TS_OK)
+            valid++;
+    }
+
+    return valid;
+}
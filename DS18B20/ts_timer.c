@@ -0,0 +1,235 @@
+/*
+ * ts_timer.c
+ *
+ * Timer2_A backend for the 1-wire bit engine
+ *
+ * Every slot is generated by the timer in up mode: TA2.1 pulls the bus low when the timer counts
+ * to TA2CCR0 and releases it when it counts to TA2CCR1, and read slots are sampled by latching
+ * CCI2A when it counts to TA2CCR2. The ISR only has to queue the next bit before the next slot
+ * releases the bus, so the CPU sleeps in LPM0 for the rest of the transfer. Other interrupts
+ * can't stretch the slots, but one that delays the ISR past that point corrupts the bit, see the
+ * TS_TA_ISR_CYCLES budget in DS18B20.h.
+ *
+ * Build it with TS_BACKEND set to TS_BACKEND_TIMER, the ts_*.s files are left empty in that case
+ */
+
+#include <msp430.h>
+#include "DS18B20.h"
+
+#if TS_BACKEND == TS_BACKEND_TIMER
+
+
+
+static char*            tsTaBuf;                // byte of the buffer being transferred
+static volatile int     tsTaCount;              // bits left in the transfer
+static unsigned char    tsTaData;               // byte being shifted in or out
+static char             tsTaBit;                // bit position inside tsTaData
+static unsigned char    tsTaCrc;                // CRC of the bits read
+static char             tsTaRead;               // the TA2CCR2 event samples a read slot instead of queuing a write
+static volatile char    tsTaBusy;
+static char             tsTaSpu;                // strong pull-up bits turned on once the last bit is written
+
+
+
+
+static void tsTaRun(unsigned int period, unsigned int low, unsigned int event, char* buf, int bits, char read)
+{
+    unsigned int gie = __get_SR_register() & GIE;
+
+    tsTaBuf   = buf;
+    tsTaCount = bits;
+    tsTaData  = read ? 0 : *buf;
+    tsTaBit   = 0;
+    tsTaCrc   = 0;
+    tsTaRead  = read;
+    tsTaBusy  = 1;
+
+    TA2CTL    = TASSEL_2|TACLR;                 // stop the timer and select SMCLK
+    TA2CCR0   = period;
+    TA2CCR1   = low;
+    TA2CCR2   = event;
+
+/*  reads shift in the bit once the bus is sampled and writes queue the next
+    bit once the latest release is over. Only the release of the last bit
+    written is an event, so the strong pull-up can follow it right away      */
+    TA2CCTL0  = 0;
+    TA2CCTL1  = (!read && bits == 1) ? OUTMOD_7|CCIE : OUTMOD_7;
+    TA2CCTL2  = (!read && bits == 1) ? CCIS_0 : CCIS_0|CCIE;
+
+    // the first slot starts on the next clock instead of a whole period later
+    TA2R      = period - 1;
+    TA2CTL    = TASSEL_2|MC_1;
+
+    // sleep until the last slot is over
+    __disable_interrupt();
+
+    while(tsTaBusy)
+    {
+        __bis_SR_register(LPM0_bits|GIE);
+        __disable_interrupt();
+    }
+
+    // the interrupts are only left enabled if the caller had them
+    __bis_SR_register(gie);
+}
+
+static void tsTaFinish()
+{
+    // keep the bus released and let the current slot run until the end of its period
+    TA2CCTL1  = OUTMOD_0;
+    TA2CCTL2  = 0;
+    TA2CCTL0  = CCIE;
+}
+
+
+
+
+void tsInit()
+{
+    TA2CTL    = MC_0;
+    TA2CCTL1  = OUTMOD_0;                       // release the bus
+    TS_SPU_OFF;
+
+    // TA2.1 drives the transistor and CCI2A samples the bus
+    P2DIR    |=  TS_TA_OUTBIT;
+    P2DIR    &= ~TS_TA_INBIT;
+    P2SEL    |=  TS_TA_OUTBIT|TS_TA_INBIT;
+
+    TS_SPU_DIR |= TS_SPU_BIT;
+}
+
+int tsMstRst()
+{
+    char presence;
+
+    // a reset is a single read slot with a long low time
+    tsTaRun(TS_TA_RST_SLOT, TS_TA_RST_LOW, TS_TA_RST_SAMPLE, &presence, 1, 1);
+
+    return (tsTaData & BIT7) ? -1 : 0;
+}
+
+char tsWriteByte(char byte)
+{
+    tsTaRun(TS_TA_SLOT, (byte & BIT0) ? TS_TA_LOW_1 : TS_TA_LOW_0, TS_TA_QUEUE, &byte, 8, 0);
+
+    return byte;
+}
+
+char tsWriteByteStrong(char byte, char spu)
+{
+    tsTaSpu = spu;
+    tsWriteByte(byte);
+    tsTaSpu = 0;
+
+    return byte;
+}
+
+void tsWriteBit(char polarity)
+{
+    tsTaRun(TS_TA_SLOT, (polarity & BIT0) ? TS_TA_LOW_1 : TS_TA_LOW_0, TS_TA_QUEUE, &polarity, 1, 0);
+}
+
+char* tsReadData(char* byte, int bufLen)
+{
+    tsTaRun(TS_TA_SLOT, TS_TA_LOW_1, TS_TA_SAMPLE, byte, bufLen * 8, 1);
+
+    return byte;
+}
+
+char tsReadDataCrc(char* byte, int bufLen)
+{
+    tsTaRun(TS_TA_SLOT, TS_TA_LOW_1, TS_TA_SAMPLE, byte, bufLen * 8, 1);
+
+    return tsTaCrc;
+}
+
+int tsReadBit()
+{
+    char bit;
+
+    tsTaRun(TS_TA_SLOT, TS_TA_LOW_1, TS_TA_SAMPLE, &bit, 1, 1);
+
+    return (tsTaData & BIT7) ? 1 : 0;
+}
+
+
+
+
+#pragma vector = TIMER2_A0_VECTOR
+__interrupt void tsTaEndIsr()
+{
+    // the period of the last slot is over, stop the timer and wake up the CPU
+    TA2CTL    = MC_0;
+    TA2CCTL0  = 0;
+
+    tsTaBusy  = 0;
+
+    __bic_SR_register_on_exit(LPM0_bits);
+}
+
+#pragma vector = TIMER2_A1_VECTOR
+__interrupt void tsTaSlotIsr()
+{
+    char bit;
+
+    switch(__even_in_range(TA2IV, 14))
+    {
+    case TA2IV_TACCR1:
+
+        // the last bit was just released, the strong pull-up can't wait for the end of the slot
+        TS_SPU_OUT |= tsTaSpu;
+        tsTaFinish();
+
+        break;
+
+    case TA2IV_TACCR2:
+
+        if(!tsTaRead)
+        {
+/*          the current slot released the bus even if it wrote a 0, so the
+            timer only counts to the new compare value in the next slot. The
+            last bit is finished by its release instead                       */
+            if(++tsTaBit == 8)
+            {
+                tsTaBit  = 0;
+                tsTaData = *(++tsTaBuf);
+            }
+            else tsTaData >>= 1;
+
+            TA2CCR1 = (tsTaData & BIT0) ? TS_TA_LOW_1 : TS_TA_LOW_0;
+
+            if(--tsTaCount == 1)
+            {
+                TA2CCTL2 = CCIS_0;
+                TA2CCTL1 = OUTMOD_7|CCIE;
+            }
+
+            break;
+        }
+
+        // the bus was latched into SCCI, shift it in lsb first and update the CRC
+        bit = (TA2CCTL2 & SCCI) ? 1 : 0;
+
+        tsTaData >>= 1;
+        if(bit)
+            tsTaData |= BIT7;
+
+        if((tsTaCrc ^ bit) & BIT0)
+            tsTaCrc = (tsTaCrc >> 1) ^ 0x8C;
+        else
+            tsTaCrc >>= 1;
+
+        if(++tsTaBit == 8)
+        {
+            tsTaBit = 0;
+            *tsTaBuf++ = tsTaData;
+        }
+
+        if(--tsTaCount == 0)
+            tsTaFinish();
+
+        break;
+    }
+}
+
+#endif
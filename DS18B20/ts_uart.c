@@ -0,0 +1,219 @@
+/*
+ * ts_uart.c
+ *
+ * USCI_A0 backend for the 1-wire bit engine
+ *
+ * Each 1-wire slot is emulated by one UART byte, and the DMA moves the slot bytes in and out of
+ * the UART so the CPU can sleep in LPM0 for the whole transfer. The bytes are only packed into
+ * bits once the DMA is done.
+ *
+ * Build it with TS_BACKEND set to TS_BACKEND_UART, the ts_*.s files are left empty in that case
+ */
+
+#include <msp430.h>
+#include "DS18B20.h"
+
+#if TS_BACKEND == TS_BACKEND_UART
+
+
+
+static unsigned char         tsUartSlots[TS_UART_MAX_BYTES * 8];    // one byte per slot
+static const unsigned char   tsUartOne = TS_UART_ONE;               // source of every read slot
+static volatile char         tsUartBusy;
+static char                  tsUartSpu;                             // strong pull-up bits turned on once the last slot is read back
+
+
+
+
+static void tsUartBaud(unsigned int br, char brs)
+{
+    UCA0CTL1 |=  UCSWRST;
+    UCA0BR0   =  br;
+    UCA0BR1   =  br >> 8;
+    UCA0MCTL  =  (brs << 1)|UCBRF_0;            // UCBRSx starts at bit 1
+    UCA0CTL1 &= ~UCSWRST;
+}
+
+static void tsUartRun(const unsigned char* tx, int txIncr, int slots)
+{
+    unsigned int gie = __get_SR_register() & GIE;
+
+    tsUartBusy = 1;
+
+    (void)UCA0RXBUF;                            // drop any stale byte
+
+    // DMA1 stores what the bus saw for each slot
+    __data16_write_addr((unsigned short)&DMA1SA, (unsigned long)&UCA0RXBUF);
+    __data16_write_addr((unsigned short)&DMA1DA, (unsigned long)tsUartSlots);
+    DMA1SZ  = slots;
+    DMA1CTL = DMADT_0|DMASRCINCR_0|DMADSTINCR_3|DMASBDB|DMAIE|DMAEN;
+
+    // DMA0 sends the slots, reads send the same byte over and over
+    __data16_write_addr((unsigned short)&DMA0SA, (unsigned long)tx);
+    __data16_write_addr((unsigned short)&DMA0DA, (unsigned long)&UCA0TXBUF);
+    DMA0SZ  = slots;
+    DMA0CTL = DMADT_0|(txIncr ? DMASRCINCR_3 : DMASRCINCR_0)|DMADSTINCR_0|DMASBDB|DMAEN;
+
+    // the DMA only triggers on a rising UCTXIFG
+    UCA0IFG &= ~UCTXIFG;
+    UCA0IFG |=  UCTXIFG;
+
+    // sleep until the last slot is read back
+    __disable_interrupt();
+
+    while(tsUartBusy)
+    {
+        __bis_SR_register(LPM0_bits|GIE);
+        __disable_interrupt();
+    }
+
+    // give the caller back its own GIE
+    __bis_SR_register(gie);
+}
+
+static void tsUartWrite(char byte, int bits)
+{
+    int i;
+
+    for(i = 0; i < bits; i++)
+    {
+        tsUartSlots[i] = (byte & BIT0) ? TS_UART_ONE : TS_UART_ZERO;
+        byte >>= 1;
+    }
+
+    // the echo of each slot is written over the slot it was sent from
+    tsUartRun(tsUartSlots, 1, bits);
+}
+
+static char tsUartPack(const unsigned char* slots)
+{
+    char byte = 0;
+    int  i;
+
+    // a read slot is a 1 only if the bus stayed high for the whole byte
+    for(i = 0; i < 8; i++)
+    {
+        if(slots[i] == TS_UART_ONE)
+            byte |= 1 << i;
+    }
+
+    return byte;
+}
+
+
+
+
+void tsInit()
+{
+    P3SEL    |= TS_UART_TXBIT|TS_UART_RXBIT;
+
+    TS_SPU_OFF;
+    TS_SPU_DIR |= TS_SPU_BIT;
+
+    UCA0CTL1  = UCSWRST|UCSSEL_2;               // SMCLK
+    UCA0CTL0  = 0;                              // 8N1, lsb first
+    tsUartBaud(TS_UART_BR_SLOT, TS_UART_BRS_SLOT);
+
+    DMACTL0   = (TS_UART_RX_TRIG << 8)|TS_UART_TX_TRIG;
+    DMACTL4   = DMARMWDIS;
+}
+
+int tsMstRst()
+{
+    unsigned char reset = TS_UART_RST_BYTE;
+
+    tsUartBaud(TS_UART_BR_RST, TS_UART_BRS_RST);
+    tsUartRun(&reset, 0, 1);
+    tsUartBaud(TS_UART_BR_SLOT, TS_UART_BRS_SLOT);
+
+    // a presence pulse pulls some of the high bits low
+    return (tsUartSlots[0] != TS_UART_RST_BYTE) ? 0 : -1;
+}
+
+char tsWriteByte(char byte)
+{
+    tsUartWrite(byte, 8);
+
+    return byte;
+}
+
+char tsWriteByteStrong(char byte, char spu)
+{
+    tsUartSpu = spu;
+    tsUartWrite(byte, 8);
+    tsUartSpu = 0;
+
+    return byte;
+}
+
+void tsWriteBit(char polarity)
+{
+    tsUartWrite(polarity, 1);
+}
+
+char* tsReadData(char* byte, int bufLen)
+{
+    int chunk, i;
+    char* data = byte;
+
+    while(bufLen > 0)
+    {
+        chunk = (bufLen > TS_UART_MAX_BYTES) ? TS_UART_MAX_BYTES : bufLen;
+
+        tsUartRun(&tsUartOne, 0, chunk * 8);
+
+        for(i = 0; i < chunk; i++)
+            *data++ = tsUartPack(&tsUartSlots[i * 8]);
+
+        bufLen -= chunk;
+    }
+
+    return byte;
+}
+
+char tsReadDataCrc(char* byte, int bufLen)
+{
+    tsReadData(byte, bufLen);
+
+    return tsCalcCrc(byte, bufLen);
+}
+
+int tsReadBit()
+{
+    tsUartRun(&tsUartOne, 0, 1);
+
+    return (tsUartSlots[0] == TS_UART_ONE) ? 1 : 0;
+}
+
+
+
+
+int tsUartDmaIsr()
+{
+    // the last slot was read back
+    if(DMA1CTL & DMAIFG)
+    {
+        DMA1CTL   &= ~DMAIFG;
+        tsUartBusy = 0;
+
+        // the stop bit of the last slot was just received, the bus is released
+        TS_SPU_OUT |= tsUartSpu;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+#if TS_UART_DMA_ISR
+
+#pragma vector = DMA_VECTOR
+__interrupt void tsUartDmaVector()
+{
+    if(tsUartDmaIsr())
+        __bic_SR_register_on_exit(LPM0_bits);
+}
+
+#endif
+
+#endif
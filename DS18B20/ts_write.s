@@ -7,8 +7,16 @@
 ;			. Total write time 		= 	61.035us (theorical)
 ;			. Period of one bit 	= 	72.479us (theorical)
 ;			. Time to send 1 byte 	=  568.388us (theorical)
+;			. Interrupts are only masked from the start of a slot until the bus is released for a 1, or for the first
+;			cycles of the low pulse of a 0, and the interrupt state of the caller is restored in the rest of the slot
+;			. An interrupt that lands in the low pulse of a 0 stretches it, so once the bus is released the slot is
+;			checked for a presence pulse. If the sensors took the stretched pulse as a reset, tsOverrun is set and
+;			tsRunScript runs the transaction again
+;			. tsWriteByteStrong turns on the strong pull-up bits passed in spu as soon as the bus is released in the
+;			last slot, so a parasite powered sensor gets its power within a few cycles of the command
 ;
 ; Inputs:		byte - 1 byte to be send
+;			spu  - strong pull-up bits of TS_SPU_OUT to turn on at the end of the byte (tsWriteByteStrong only)
 ;
 ; Outputs:		none
 ;
@@ -23,50 +31,113 @@
         	    .define R12, byte						; R12 is also the register with the address of the keypad data
         	    .define R13, oneByteReg					; R13 holds the number of iterations needed
 		    .define R14, int_ret_reg					; R14 keeps the value used to count the amount of iterations needed
+		    .define R15, gie						; R15 keeps the GIE bit of the caller, it is a save-on-call register
+		    .define R11, spu						; R11 keeps the strong pull-up bits, it is a save-on-call register
 ;------------------------------------------------------------------------------------------------------------------------------
 ; Define functions constants
 ;------------------------------------------------------------------------------------------------------------------------------
 ONE_BYTE 		.equ	8								; 8-bits
-CYCLE_DELAY		.equ	18								; CYCLE_DELAY = ([63 cycles] - [9 cycles])/([3 cycles per iteration])
+; the delay loop counter TS_CYCLE_DELAY_W and the padding TS_PAD_LOW are generated from TS_MCLK_HZ in DS18B20.h
+SENTINEL		.equ	-1								; the PC pushed by an interrupt is always even, so it can't be -1
 ;------------------------------------------------------------------------------------------------------------------------------
 ; Code Section
 ;------------------------------------------------------------------------------------------------------------------------------
+				.if	TS_BACKEND == TS_BACKEND_ASM			; only assembled when the assembly backend is selected
+
 				.text
 				.global tsWriteByte						; declare tsWriteByte as global
+				.global tsWriteByteStrong					; declare tsWriteByteStrong as global
+				.global tsOverrun						; set once a stretched slot was taken as a reset, from DS18B20.c
+
+tsWriteByteStrong:
+				mov.b	R13, spu						; the strong pull-up bits are passed in R13
+				jmp	write_byte
 
 tsWriteByte:
-				push	oneByteReg						; save contents of R13
+				clr	spu							; no strong pull-up after the byte
+
+write_byte:			push	oneByteReg						; save contents of R13
 				push	int_ret_reg						; save contents of R14
 
+				mov	SR, gie							; keep the interrupt state of the caller
+				and	#GIE, gie
+
 				mov	#ONE_BYTE, oneByteReg					; move the number of iterations needed to send 1 byte to R13
 
-send_data:			mov.b	#TS_CYCLE_DELAY_W, int_ret_reg				; [cycles: 2] number of cycles needed to delay 60us
+send_data:			mov	#TS_CYCLE_DELAY_W, int_ret_reg				; [cycles: 2] number of cycles needed to delay 60us
+				mov	#SENTINEL, -2(SP)					; [cycles: 4] an interrupt overwrites the word below the stack
 				rrc.b	byte							; [cycles: 1] shift the byte to be sent
+				dint								; [cycles: 1] mask the interrupts for the start of the slot
+				nop								; [cycles: 1] dint takes effect after the next instruction
 				jc	send_H							; [cycles: 2] if the carry flag is up, send a high
 
 send_L:				bis.b	#TS_OUTBIT, &TS_OUT					; [cycles: 4] pull the bus low and keep it low if no carry bit
+				.if	TS_PAD_LOW > 0
+				.loop	TS_PAD_LOW					; [cycles: TS_PAD_LOW] add the same padding as send_H
+				nop
+				.endloop
+				.endif
 				nop								; [cycles: 1] add an extra cycle to match send_H
 				nop								; [cycles: 1] add an extra cycle to match send_H
 				nop								; [cycles: 1] add an extra cycle to match send_H
-				jmp	delay_loop						; [cycles: 2] jump to delay
+				jmp	unmask							; [cycles: 2] jump to delay
 
 send_H:				bis.b	#TS_OUTBIT, &TS_OUT					; [cycles: 4] pull the bus low to send a wakeup signal
+				.if	TS_PAD_LOW > 0
+				.loop	TS_PAD_LOW					; [cycles: TS_PAD_LOW] keep the bus low for at least 2us on fast clocks
+				nop
+				.endloop
+				.endif
 				bic.b	#TS_OUTBIT, &TS_OUT					; [cycles: 4] release the bus
 				nop								; [cycles: 1] add an extra cycle to match exactly 63 cycles
 
+unmask:				bis	gie, SR							; [cycles: 1] the rest of the slot can be interrupted
+
 delay_loop:			dec	int_ret_reg						; [cycles: 1] decrement interation register
 				jnz	delay_loop						; [cycles: 2] keep looping unitl interation register is 0
 
-recover:			bic.b	#TS_OUTBIT, &TS_OUT					; [cycles: 4] release the bus when done
-				dec.b	oneByteReg						; [cycles: 1] decrement interation by one (count the number of bytes)
+recover:			dint								; [cycles: 1] mask the interrupts around the release
+				nop								; [cycles: 1] dint takes effect after the next instruction
+				bic.b	#TS_OUTBIT, &TS_OUT					; [cycles: 4] release the bus when done
+				cmp.b	#1, oneByteReg						; [cycles: 1] check whether this was the last slot
+				jne	check_slot						; [cycles: 2]
+				bis.b	spu, &TS_SPU_OUT					; [cycles: 4] strong pull-up right after the release of the last slot
+
+check_slot:			cmp	#SENTINEL, -2(SP)					; [cycles: 3] check whether an interrupt stretched the slot
+				jne	check_reset						; [cycles: 2] look for a presence pulse if it did
+
+next_bit:			dec.b	oneByteReg						; [cycles: 1] decrement interation by one (count the number of bytes)
 				jnz	send_data						; [cycles: 2] go back once interrupt gets triggerred
 
-return_back:			pop	int_ret_reg						; restore whatever was stored in R14
+return_back:			bis	gie, SR							; restore the interrupt state of the caller
+				pop	int_ret_reg						; restore whatever was stored in R14
 				pop	oneByteReg						; restore whatever was stored in R13
 
 				reta
 
+; the sensors answer a reset with a presence pulse 15us to 60us after the bus is released, so a bus still low after 60us means
+; the stretched slot was taken as a reset and the rest of the transaction is lost
+
+check_reset:			bis	gie, SR							; the caller's interrupts don't have to wait for the check
+				bic.b	spu, &TS_SPU_OUT					; the strong pull-up would hide a presence pulse
+				mov	#TS_CYCLE_DELAY_W, int_ret_reg				; delay 60us
+
+reset_delay:			dec	int_ret_reg						; decrement interation register
+				jnz	reset_delay						; keep looping unitl interation register is 0
+
+				bit.b	#TS_INBIT, &TS_BUS					; check the status of the bus
+				jnz	stretched						; a high bus means the slot was only stretched
+				mov.b	#1, &tsOverrun						; flag the transaction to be run again
+				jmp	next_bit
+
+stretched:			cmp.b	#1, oneByteReg						; the strong pull-up goes back on after the last slot
+				jne	next_bit
+				bis.b	spu, &TS_SPU_OUT
+				jmp	next_bit
+
+				.endif
+
 				.end
-; recovery time: 	12 cycles (apprx. 11.444us), min is 1us  (recover + send_data)
-; total write time:		63 cycles (apprx. 60.081us), min is 60us (send_X + delay_loop)
+; recovery time: 	26 cycles (apprx. 24.796us), min is 1us  (recover + send_data)
+; total write time:		63 cycles (apprx. 60.081us), min is 60us (send_X + delay_loop + recover)
 
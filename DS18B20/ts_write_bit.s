@@ -2,7 +2,7 @@
 ;
 ; Author:		Gian Moreira
 ;
-;
+; Description:		. Interrupts are masked and the slot is checked for an overrun the same way as in tsWriteByte
 ;
 ; Inputs:		byte - 1 byte to be send
 ;
@@ -17,40 +17,81 @@
 ; Register definitions
 ;------------------------------------------------------------------------------------------------------------------------------
         	    .define R12, byte						; R12 is also the register with the address of the keypad data
-        	    .define R13, oneByteReg					; R13 holds the number of iterations needed
 		    .define R14, int_ret_reg					; R14 keeps the value used to count the amount of iterations needed
+		    .define R13, gie						; R13 keeps the GIE bit of the caller, it is a save-on-call register
 ;------------------------------------------------------------------------------------------------------------------------------
 ; Define functions constants
 ;------------------------------------------------------------------------------------------------------------------------------
 ONE_BYTE 		.equ	8						; 8-bits
-CYCLE_DELAY		.equ	18						; CYCLE_DELAY = ([63 cycles] - [9 cycles])/([3 cycles per iteration])
+; the delay loop counter TS_CYCLE_DELAY_W and the padding TS_PAD_LOW are generated from TS_MCLK_HZ in DS18B20.h
+SENTINEL		.equ	-1						; the PC pushed by an interrupt is always even, so it can't be -1
 ;------------------------------------------------------------------------------------------------------------------------------
 ; Code Section
 ;------------------------------------------------------------------------------------------------------------------------------
+				.if	TS_BACKEND == TS_BACKEND_ASM			; only assembled when the assembly backend is selected
+
 				.text
 				.global tsWriteBit				; declare tsWriteByte as global
+				.global tsOverrun				; set once a stretched slot was taken as a reset, from DS18B20.c
 
 tsWriteBit:
 				push	int_ret_reg				; save contents of R14
 
+				mov	SR, gie					; keep the interrupt state of the caller
+				and	#GIE, gie
+
 send_data:
-				mov.b	#CYCLE_DELAY, int_ret_reg		; number of cycles needed to delay 60us
+				mov	#TS_CYCLE_DELAY_W, int_ret_reg		; number of cycles needed to delay 60us
+				mov	#SENTINEL, -2(SP)			; an interrupt overwrites the word below the stack
 				rrc.b	byte					; shift the byte to be sent
+				dint						; mask the interrupts for the start of the slot
+				nop						; dint takes effect after the next instruction
 				jc	send_H					; if the carry flag is up, send a high
 
 send_L:				bis.b	#TS_OUTBIT, &TS_OUT			; [cycles: 4] pull the bus low and keep it low if no carry bit
+				.if	TS_PAD_LOW > 0
+				.loop	TS_PAD_LOW					; [cycles: TS_PAD_LOW] add the same padding as send_H
+				nop
+				.endloop
+				.endif
 				nop						; [cycles: 1] add an extra cycle to match send_H
 				nop						; [cycles: 1] add an extra cycle to match send_H
 				nop						; [cycles: 1] add an extra cycle to match send_H
-				jmp	delay_loop				; [cycles: 2] jump to delay
+				jmp	unmask					; [cycles: 2] jump to delay
 
 send_H:				bis.b	#TS_OUTBIT, &TS_OUT			; [cycles: 4] pull the bus low to send a wakeup signal
+				.if	TS_PAD_LOW > 0
+				.loop	TS_PAD_LOW					; [cycles: TS_PAD_LOW] keep the bus low for at least 2us on fast clocks
+				nop
+				.endloop
+				.endif
 				bic.b	#TS_OUTBIT, &TS_OUT			; [cycles: 4] release the bus
 				nop						; [cycles: 1] add an extra cycle to match exactly 63 cycles
 
+unmask:				bis	gie, SR					; [cycles: 1] the rest of the slot can be interrupted
+
 delay_loop:			dec	int_ret_reg				; [cycles: 1] decrement interation register
 				jnz	delay_loop				; [cycles: 2] keep looping unitl interation register is 0
 
-return_back:			pop	int_ret_reg				; restore whatever was stored in R14
+recover:			dint						; [cycles: 1] mask the interrupts around the release
+				nop						; [cycles: 1] dint takes effect after the next instruction
+				bic.b	#TS_OUTBIT, &TS_OUT			; [cycles: 4] release the bus when done, otherwise a 0 keeps it low
+				cmp	#SENTINEL, -2(SP)			; check whether an interrupt stretched the slot
+				jeq	return_back
+
+				bis	gie, SR					; the caller's interrupts don't have to wait for the check
+				mov	#TS_CYCLE_DELAY_W, int_ret_reg		; look for a presence pulse 60us after the release
+
+reset_delay:			dec	int_ret_reg				; decrement interation register
+				jnz	reset_delay				; keep looping unitl interation register is 0
+
+				bit.b	#TS_INBIT, &TS_BUS			; a high bus means the slot was only stretched
+				jnz	return_back
+				mov.b	#1, &tsOverrun				; flag the transaction to be run again
+
+return_back:			bis	gie, SR					; restore the interrupt state of the caller
+				pop	int_ret_reg				; restore whatever was stored in R14
 
 				reta
+
+				.endif
@@ -12,6 +12,35 @@ volatile char i2cTxBuffer[I2C_MAX_BUF];         // TxBuffer is used by the txIsr
 volatile char i2cRxBuffer[I2C_MAX_BUF];         // RxBuffer is used by the rxIsr
 volatile int  i2cTxBufLen = 0;
 volatile int  i2cRxBufLen = 0;
+volatile int  i2cRxResult = I2C_OK;             // status of the last ucsiB0I2CRxCharNoPoll
+
+
+// state of the DMA mode
+#define I2C_DMA_OFF     0
+#define I2C_DMA_TX      1           // DMA2 is feeding UCB0TXBUF
+#define I2C_DMA_TX_LAST 2           // the last byte is in UCB0TXBUF, the next UCTXIFG ends the job or its write phase
+#define I2C_DMA_RX      3           // DMA2 is emptying UCB0RXBUF into a segment
+#define I2C_DMA_RX_TAIL 4           // DMA2 is receiving every byte of the last segment but its last one
+#define I2C_DMA_RX_LAST 5           // the STOP or the next START is set and DMA2 waits for the last byte
+#define I2C_DMA_TX_ACK  6           // the last byte is out, the STOP or the START of the next job shows it was acknowledged
+#define I2C_DMA_STOP    7           // i2cCur waits for the STOP of the previous transaction to be out
+
+#define I2C_QUEUE_MASK  (I2C_QUEUE_LEN - 1)
+
+static volatile char        i2cDmaMode   = I2C_DMA_OFF;
+static const I2CSegment*    i2cDmaSeg;              // next segment of the job
+static const I2CSegment*    i2cDmaEnd;              // past the last segment
+static char*                i2cDmaLast;             // where the last byte of a receive goes
+static I2CSegment           i2cDmaOne;              // segment of ucsiB0I2CTxDma and ucsiB0I2CRxDma
+static I2CSegment           i2cDmaRxOne;            // read segment of ucsiB0I2CWriteRead
+static I2CJob               i2cDmaJob = {0, 0, 0, 0, 0, 0, 0, I2C_OK};    // job of the single transaction calls
+
+// the queue only holds pointers, the jobs belong to the callers
+static I2CJob*                  i2cQueue[I2C_QUEUE_LEN];
+static volatile unsigned char   i2cHead = 0;        // only moved by i2cSubmit
+static volatile unsigned char   i2cTail = 0;        // only moved by i2cPop
+static I2CJob* volatile         i2cCur  = 0;        // job the DMA is working on
+static I2CJob*                  i2cNext = 0;        // job whose repeated START is set while i2cCur ends
 
 void ucsiB0I2CInit(char addrSize, int i2cClk)
 {
@@ -33,8 +62,8 @@ int ucsiB0I2CTxChar(char* data, int bufLen, int addr)
 {
     int success = -1;
 
-    // check if the bus is busy before sending another byte
-    if(!(UCB0STAT & UCBBUSY))
+    // check if the bus is busy before sending another byte, longer writes must use ucsiB0I2CTxSeg
+    if(!(UCB0STAT & UCBBUSY) && bufLen < I2C_MAX_BUF)
     {
         success = 0;                        // acknowledge that a transmit took place
 
@@ -59,73 +88,532 @@ int ucsiB0I2CTxChar(char* data, int bufLen, int addr)
 }
 
 int ucsiB0I2CRxChar(char* data, int bufLen, int addr)
+{
+    int status;
+    int i;
+
+    // the DMA fills data while the CPU sleeps, only the end of the frame or a NACK wakes it up
+    if(ucsiB0I2CRxDma(data, bufLen, addr))
+        return I2C_ERR_BUSY;
+
+    status = i2cDmaWait();
+
+    // only the first I2C_MAX_BUF bytes are kept in the buffer of i2cGetRxAddr
+    for(i = 0; status == I2C_OK && i < bufLen && i < I2C_MAX_BUF; i++)
+        i2cRxBuffer[i] = data[i];
+
+    return status;
+}
+
+int ucsiB0I2CRxCharNoPoll(char** data, int bufLen, int addr)
 {
     int success = -1;
 
-    // check if the buffer is being used before initiating a receive
-    if(!(UCB0STAT & UCBBUSY))
+    // the ISR stores one byte past bufLen, longer reads must use ucsiB0I2CRxSeg
+    if(!(UCB0STAT & UCBBUSY) && bufLen < I2C_MAX_BUF)
     {
         success = 0;
-
         i2cRxBuffer[0] = UCB0RXBUF;
 
+        *data = i2cRxBuffer;
+        i2cRxBufLen = bufLen;
+        i2cRxResult = I2C_PENDING;
+
         UCB0I2CSA = addr;
 
         UCB0CTL1 &= ~UCTR;
 
+        UCB0IFG &= ~UCRXIFG;
+
         UCB0CTL1 |= UCTXSTT;
 
-        volatile unsigned int i;
-        for(i = 0; i < bufLen; i++)
-        {
+        UCB0IE   |= UCRXIE;
+    }
 
-            while(!(UCB0IFG & UCRXIFG));
+    return success;
+}
 
-            i2cRxBuffer[i] = UCB0RXBUF;
+volatile char* i2cGetRxAddr()
+{
+    return i2cRxBuffer;
+}
 
-            data[i] = i2cRxBuffer[i];
+int i2cRxStatus()
+{
+    return i2cRxResult;
+}
 
-        }
+static void i2cDmaRun(unsigned long src, unsigned long dst, unsigned int size, unsigned int incr)
+{
+    __data16_write_addr((unsigned short)&DMA2SA, src);
+    __data16_write_addr((unsigned short)&DMA2DA, dst);
+    DMA2SZ  = size;
+    DMA2CTL = DMADT_0|incr|DMASBDB|DMAIE|DMAEN;
+}
 
-        UCB0CTL1 |=  UCTXSTP;
-        UCB0IFG  &= ~UCRXIFG;
-//*/
+static void i2cDmaTxEdge()
+{
+    // UCB0TXBUF emptied before DMA2 was armed left UCTXIFG set without an edge, it has to rise again
+    if(UCB0IFG & UCTXIFG)
+    {
+        UCB0IFG &= ~UCTXIFG;
+        UCB0IFG |=  UCTXIFG;
     }
+}
 
-    return success;
+static void i2cDmaRxEdge()
+{
+    // a byte received before DMA2 was armed left UCRXIFG set without an edge, it has to rise again
+    if(UCB0IFG & UCRXIFG)
+    {
+        UCB0IFG &= ~UCRXIFG;
+        UCB0IFG |=  UCRXIFG;
+    }
 }
 
-int ucsiB0I2CRxCharNoPoll(char** data, int bufLen, int addr)
+static int i2cDmaSkip()
 {
-    int success = -1;
+    // empty segments are skipped, returns 0 once there is no segment left
+    while(i2cDmaSeg < i2cDmaEnd && !i2cDmaSeg->len)
+        i2cDmaSeg++;
+
+    return i2cDmaSeg < i2cDmaEnd;
+}
 
-    if(!(UCB0STAT & UCBBUSY))
+static int i2cSegSize(const I2CSegment* segs, int nSegs)
+{
+    // 0 when there is no byte, 1 for a single byte and 2 for anything longer
+    unsigned int n = 0;
+    int i;
+
+    for(i = 0; i < nSegs; i++)
     {
-        success = 0;
-        i2cRxBuffer[0] = UCB0RXBUF;
+        if(segs[i].len > 1)
+            return 2;
 
-        *data = i2cRxBuffer;
-        i2cRxBufLen = bufLen;
+        n += segs[i].len;
 
-        UCB0I2CSA = addr;
+        if(n > 1)
+            return 2;
+    }
 
-        UCB0CTL1 &= ~UCTR;
+    return n;
+}
 
+static I2CJob* i2cPop()
+{
+    I2CJob* job;
+
+    if(i2cTail == i2cHead)
+        return 0;
+
+    job     = i2cQueue[i2cTail];
+    i2cTail = (i2cTail + 1) & I2C_QUEUE_MASK;
+
+    return job;
+}
+
+static void i2cEnd();
+
+static void i2cDmaTxNext()
+{
+    i2cDmaRun((unsigned long)i2cDmaSeg->data, (unsigned long)&UCB0TXBUF, i2cDmaSeg->len, DMASRCINCR_3|DMADSTINCR_0);
+    i2cDmaSeg++;
+}
+
+static void i2cDmaRxNext()
+{
+    const I2CSegment* seg = i2cDmaSeg++;
+
+    if(i2cDmaSkip())
+    {
+        i2cDmaMode = I2C_DMA_RX;
+        i2cDmaRun((unsigned long)&UCB0RXBUF, (unsigned long)seg->data, seg->len, DMASRCINCR_0|DMADSTINCR_3);
+        return;
+    }
+
+    // the last byte of the job is received on its own, after the STOP or the next START is set
+    i2cDmaLast = &seg->data[seg->len - 1];
+
+    if(seg->len > 1)
+    {
+        i2cDmaMode = I2C_DMA_RX_TAIL;
+        i2cDmaRun((unsigned long)&UCB0RXBUF, (unsigned long)seg->data, seg->len - 1, DMASRCINCR_0|DMADSTINCR_3);
+    }
+    else
+    {
+        i2cDmaMode = I2C_DMA_RX_LAST;
+        i2cDmaRun((unsigned long)&UCB0RXBUF, (unsigned long)i2cDmaLast, 1, DMASRCINCR_0|DMADSTINCR_0);
+        i2cEnd();
+    }
+}
+
+static void i2cDmaStart(const I2CSegment* segs, int nSegs, char read, int restart)
+{
+    i2cDmaSeg = segs;
+    i2cDmaEnd = segs + nSegs;
+    i2cDmaSkip();
+
+    if(!read)
+    {
+        i2cDmaMode = I2C_DMA_TX;
+
+        DMACTL1 = (DMACTL1 & 0xFF00)|I2C_DMA_TX_TRIG;     // DMA2 is in the low byte
+        i2cDmaTxNext();
+
+        // the repeated START may have set UCTXIFG before DMA2 was armed
+        if(restart)
+            i2cDmaTxEdge();
+
+        return;
+    }
+
+    DMACTL1 = (DMACTL1 & 0xFF00)|I2C_DMA_RX_TRIG;
+
+    if(i2cSegSize(segs, nSegs) > 1)
+        i2cDmaRxNext();
+    else
+    {
+        // the STOP of a single byte is set by i2cBusStart
+        i2cDmaMode = I2C_DMA_RX_LAST;
+        i2cDmaRun((unsigned long)&UCB0RXBUF, (unsigned long)i2cDmaSeg->data, 1, DMASRCINCR_0|DMADSTINCR_0);
+    }
+
+    // the repeated START was set while the job before it ended, its first byte may already be in
+    if(restart)
+        i2cDmaRxEdge();
+}
+
+static void i2cBusStart(int addr, char read, int size, int restart)
+{
+    unsigned int wait;
+
+    UCB0I2CSA = addr;
+
+    if(!read)
+    {
+        // the DMA only triggers on a rising UCTXIFG, which the START sets
+        UCB0IFG  &= ~UCTXIFG;
+        UCB0CTL1 |=  UCTR|UCTXSTT;
+        return;
+    }
+
+    // on a restart the last byte of the previous receive may still be on its way to DMA2
+    if(!restart)
         UCB0IFG &= ~UCRXIFG;
 
-        UCB0CTL1 |= UCTXSTT;
+    UCB0CTL1 &= ~UCTR;
+    UCB0CTL1 |=  UCTXSTT;
 
-        UCB0IE   |= UCRXIE;
+    // a single byte needs the STOP while it is received, and only UCTXSTT tells when its address is out. The wait is
+    // bounded, a STOP set after a timeout still ends the read
+    if(size < 2)
+    {
+        for(wait = I2C_STT_WAIT; wait && (UCB0CTL1 & UCTXSTT); wait--);
+        UCB0CTL1 |= UCTXSTP;
     }
+}
 
-    return success;
+static void i2cKick(I2CJob* job)
+{
+    // starts a job on an idle driver, the oldest queued job if none is given
+    if(!job)
+        job = i2cPop();
+
+    i2cCur = job;
+
+    if(!job)
+    {
+        i2cDmaMode = I2C_DMA_OFF;
+        return;
+    }
+
+    // the STOP of the previous transaction must be out before the next START, the USCI ISR starts the job once it is
+    UCB0IFG &= ~UCSTPIFG;
+
+    if(UCB0CTL1 & UCTXSTP)
+    {
+        i2cDmaMode = I2C_DMA_STOP;
+        UCB0IE    |= UCSTPIE;
+        return;
+    }
+
+    i2cDmaStart(job->segs, job->nSegs, job->read, 0);
+    i2cBusStart(job->addr, job->read, i2cSegSize(job->segs, job->nSegs), 0);
 }
 
-volatile char* i2cGetRxAddr()
+static int i2cReadPhase()
 {
-    return i2cRxBuffer;
+    // a write job with a read phase turns around with a repeated START to the same slave
+    I2CJob* job = i2cCur;
+
+    if(job->read || !job->nRxSegs || !i2cSegSize(job->rxSegs, job->nRxSegs))
+        return 0;
+
+    i2cDmaStart(job->rxSegs, job->nRxSegs, 1, 1);
+    i2cBusStart(job->addr, 1, i2cSegSize(job->rxSegs, job->nRxSegs), 1);
+
+    return 1;
 }
 
+static void i2cEnd()
+{
+    // the last byte of i2cCur is on its way, the next job follows it with a repeated START
+    i2cNext = i2cPop();
+
+    if(i2cNext)
+        i2cBusStart(i2cNext->addr, i2cNext->read, i2cSegSize(i2cNext->segs, i2cNext->nSegs), 1);
+    else
+        UCB0CTL1 |= UCTXSTP;
+}
+
+static void i2cAdvance(int status)
+{
+    I2CJob* job  = i2cCur;
+    I2CJob* next = i2cNext;
+
+    i2cNext = 0;
+
+    // the next job is already running before the callback of this one is called
+    if(next && status == I2C_OK)
+    {
+        i2cCur = next;
+        i2cDmaStart(next->segs, next->nSegs, next->read, 1);
+    }
+    else
+        i2cKick(next);
+
+    job->status = status;
+
+    if(job->done)
+        job->done(job);
+}
+
+int i2cSubmit(I2CJob* job)
+{
+    unsigned int  gie = __get_SR_register() & GIE;
+    unsigned char head;
+
+    if(!i2cSegSize(job->segs, job->nSegs))
+        return -1;
+
+    __disable_interrupt();
+
+    head = (i2cHead + 1) & I2C_QUEUE_MASK;
+
+    if(head == i2cTail)
+    {
+        __bis_SR_register(gie);
+        return -1;
+    }
+
+    job->status       = I2C_PENDING;
+    i2cQueue[i2cHead] = job;
+    i2cHead           = head;
+
+    // an idle driver is started here, otherwise the ISR starts the job once the ones before it are done
+    if(!i2cCur && !(UCB0IE & (UCTXIE|UCRXIE)))
+        i2cKick(0);
+
+    __bis_SR_register(gie);
+
+    return 0;
+}
+
+int ucsiB0I2CTxSeg(const I2CSegment* segs, int nSegs, int addr)
+{
+    // the single transaction calls don't queue, they fail while anything else is running
+    if((UCB0STAT & UCBBUSY) || i2cCur || i2cDmaJob.status == I2C_PENDING)
+        return -1;
+
+    i2cDmaJob.segs  = segs;
+    i2cDmaJob.nSegs = nSegs;
+    i2cDmaJob.addr  = addr;
+    i2cDmaJob.read  = 0;
+    i2cDmaJob.done  = 0;
+
+    i2cDmaJob.nRxSegs = 0;
+
+    return i2cSubmit(&i2cDmaJob);
+}
+
+int ucsiB0I2CRxSeg(const I2CSegment* segs, int nSegs, int addr)
+{
+    if((UCB0STAT & UCBBUSY) || i2cCur || i2cDmaJob.status == I2C_PENDING)
+        return -1;
+
+    i2cDmaJob.segs  = segs;
+    i2cDmaJob.nSegs = nSegs;
+    i2cDmaJob.addr  = addr;
+    i2cDmaJob.read  = 1;
+    i2cDmaJob.done  = 0;
+
+    i2cDmaJob.nRxSegs = 0;
+
+    return i2cSubmit(&i2cDmaJob);
+}
+
+int ucsiB0I2CTxDma(const char* data, int bufLen, int addr)
+{
+    if(i2cDmaJob.status == I2C_PENDING || bufLen < 1)
+        return -1;
+
+    i2cDmaOne.data = (char*)data;
+    i2cDmaOne.len  = bufLen;
+
+    return ucsiB0I2CTxSeg(&i2cDmaOne, 1, addr);
+}
+
+int ucsiB0I2CRxDma(char* data, int bufLen, int addr)
+{
+    if(i2cDmaJob.status == I2C_PENDING || bufLen < 1)
+        return -1;
+
+    i2cDmaOne.data = data;
+    i2cDmaOne.len  = bufLen;
+
+    return ucsiB0I2CRxSeg(&i2cDmaOne, 1, addr);
+}
+
+int ucsiB0I2CWriteRead(const char* txData, int txLen, char* rxData, int rxLen, int addr)
+{
+    if((UCB0STAT & UCBBUSY) || i2cCur || i2cDmaJob.status == I2C_PENDING || txLen < 1 || rxLen < 1)
+        return -1;
+
+    i2cDmaOne.data   = (char*)txData;
+    i2cDmaOne.len    = txLen;
+    i2cDmaRxOne.data = rxData;
+    i2cDmaRxOne.len  = rxLen;
+
+    i2cDmaJob.segs    = &i2cDmaOne;
+    i2cDmaJob.nSegs   = 1;
+    i2cDmaJob.rxSegs  = &i2cDmaRxOne;
+    i2cDmaJob.nRxSegs = 1;
+    i2cDmaJob.addr    = addr;
+    i2cDmaJob.read    = 0;
+    i2cDmaJob.done    = 0;
+
+    return i2cSubmit(&i2cDmaJob);
+}
+
+int i2cRegRead(I2CRegJob* reg, int addr, unsigned int regAddr, char regSize, char* data, unsigned int len, I2CCallback done)
+{
+    if(!len)
+        return -1;
+
+    // a 16 bit register address is sent most significant byte first
+    if(regSize == I2C_REG_16)
+    {
+        reg->regAddr[0] = regAddr >> 8;
+        reg->regAddr[1] = regAddr;
+    }
+    else
+        reg->regAddr[0] = regAddr;
+
+    reg->tx.data = reg->regAddr;
+    reg->tx.len  = regSize == I2C_REG_16 ? 2 : 1;
+    reg->rx.data = data;
+    reg->rx.len  = len;
+
+    reg->job.segs    = &reg->tx;
+    reg->job.nSegs   = 1;
+    reg->job.rxSegs  = &reg->rx;
+    reg->job.nRxSegs = 1;
+    reg->job.addr    = addr;
+    reg->job.read    = 0;
+    reg->job.done    = done;
+
+    return i2cSubmit(&reg->job);
+}
+
+int i2cDmaStatus()
+{
+    return i2cDmaJob.status;
+}
+
+int i2cDmaWait()
+{
+    unsigned int gie = __get_SR_register() & GIE;
+
+    // the status is checked with the interrupts off, so the wake up can't come before the sleep
+    __disable_interrupt();
+
+    while(i2cDmaJob.status == I2C_PENDING)
+    {
+        __bis_SR_register(LPM0_bits|GIE);
+        __disable_interrupt();
+    }
+
+    // give the caller back its own GIE
+    __bis_SR_register(gie);
+
+    return i2cDmaJob.status;
+}
+
+int i2cDmaIsr()
+{
+    if(!(DMA2CTL & DMAIFG))
+        return 0;
+
+    DMA2CTL &= ~DMAIFG;
+
+    switch(i2cDmaMode)
+    {
+    case I2C_DMA_TX:
+        // the next segment goes out in the same transaction
+        if(i2cDmaSkip())
+        {
+            i2cDmaTxNext();
+            i2cDmaTxEdge();
+            return 0;
+        }
+
+        // the last byte is still in UCB0TXBUF, the USCI ISR ends the job once it is out
+        i2cDmaMode = I2C_DMA_TX_LAST;
+        UCB0IE    |= UCTXIE;
+        return 0;
+
+    case I2C_DMA_RX:
+        i2cDmaRxNext();
+        i2cDmaRxEdge();
+        return 0;
+
+    case I2C_DMA_RX_TAIL:
+        // the last byte is being received, DMA2 is armed for it before the STOP or the next START is set
+        i2cDmaMode = I2C_DMA_RX_LAST;
+        i2cDmaRun((unsigned long)&UCB0RXBUF, (unsigned long)i2cDmaLast, 1, DMASRCINCR_0|DMADSTINCR_0);
+        i2cEnd();
+        i2cDmaRxEdge();
+        return 0;
+
+    case I2C_DMA_RX_LAST:
+        i2cAdvance(I2C_OK);
+        return 1;
+    }
+
+    return 0;
+}
+
+#if I2C_DMA_ISR
+
+// the DS18B20 handler is only called if it is linked in, it resolves to 0 otherwise
+#pragma WEAK(tsUartDmaIsr)
+int tsUartDmaIsr();
+
+#pragma vector = DMA_VECTOR
+__interrupt void i2cDmaVector()
+{
+    int wake = i2cDmaIsr();
+
+    if(tsUartDmaIsr)
+        wake |= tsUartDmaIsr();
+
+    if(wake)
+        __bic_SR_register_on_exit(LPM0_bits);
+}
+
+#endif
+
 #pragma vector = USCI_B0_VECTOR
 __interrupt void ucsiB0Isr()
 {
@@ -137,6 +625,23 @@ __interrupt void ucsiB0Isr()
     switch(__even_in_range(UCB0IV, 12))
     {
     case USCI_I2C_UCNACKIFG:
+        // a job is given up right away, the DMA has already moved its first byte
+        if(i2cCur)
+        {
+            // once the address of the next job is sent, the NACK is its own and the last byte of i2cCur was acknowledged
+            if(i2cDmaMode == I2C_DMA_TX_ACK && i2cNext && !(UCB0CTL1 & UCTXSTT))
+                i2cAdvance(I2C_OK);
+
+            DMA2CTL  &= ~DMAEN;
+            UCB0CTL1 |=  UCTXSTP;
+            UCB0IE   &= ~(UCTXIE|UCRXIE|UCSTPIE);
+
+            i2cAdvance(I2C_ERR_NACK);
+
+            __bic_SR_register_on_exit(LPM0_bits);
+            break;
+        }
+
         nackEvent++;            // count the number of nack events
 
         // if nack event is less than 2 try again
@@ -148,16 +653,51 @@ __interrupt void ucsiB0Isr()
         {
             UCB0CTL1 |=  UCTXSTP;       // if more than two nack in a row, stop the transmission
             nackEvent = 0;
+
+            // a receive that never started is over too
+            if(i2cRxResult == I2C_PENDING)
+            {
+                UCB0IE     &= ~UCRXIE;
+                i2cRxResult = I2C_ERR_NACK;
+
+                __bic_SR_register_on_exit(LPM0_bits);
+            }
         }
 
         rxBufIdx = 0;
         txBufIdx = 0;
 
         break;
+
+    case USCI_I2C_UCSTPIFG:
+
+        UCB0IE &= ~UCSTPIE;
+
+        // the STOP is out, so the last byte of i2cCur was acknowledged or the job waiting for it can start
+        if(i2cDmaMode == I2C_DMA_TX_ACK)
+        {
+            i2cAdvance(I2C_OK);
+            __bic_SR_register_on_exit(LPM0_bits);
+        }
+        else if(i2cDmaMode == I2C_DMA_STOP)
+            i2cKick(i2cCur);
+
+        break;
+
     // Ideally this is was planned with the system flag in mind, but I might as well just poll the rxBuf without an interrupt
         //*
     case USCI_I2C_UCRXIFG:
 
+        // the first byte of the next job shows the last byte of i2cCur was acknowledged, DMA2 is armed for it
+        if(i2cDmaMode == I2C_DMA_TX_ACK)
+        {
+            UCB0IE &= ~UCRXIE;
+            i2cAdvance(I2C_OK);
+
+            __bic_SR_register_on_exit(LPM0_bits);
+            break;
+        }
+
         i2cRxBuffer[rxBufIdx++] = UCB0RXBUF;
 
         // once the interrupt is equal to zero, stop receiving data and release the i2c bus
@@ -170,7 +710,14 @@ __interrupt void ucsiB0Isr()
             // reset all events
             nackEvent =  0;
             txBufIdx  =  0;
-            rxBufIdx  = -1;
+            rxBufIdx  =  0;
+
+            // the whole frame is in the buffer
+            i2cRxResult = I2C_OK;
+            __bic_SR_register_on_exit(LPM0_bits);
+
+            // jobs submitted meanwhile waited for the buffered transaction
+            i2cKick(0);
         }
 
         break;
@@ -178,6 +725,40 @@ __interrupt void ucsiB0Isr()
 
     case USCI_I2C_UCTXIFG:
 
+        // the last byte of a DMA transmit left UCB0TXBUF, the interrupt is off before a restart sets UCTXIFG
+        if(i2cDmaMode == I2C_DMA_TX_LAST)
+        {
+            UCB0IE &= ~UCTXIE;
+
+            // the job isn't done until its read phase is
+            if(i2cReadPhase())
+                break;
+
+            // a NACK of the last byte still belongs to i2cCur, it is only done once the STOP or the next START is out
+            i2cEnd();
+            i2cDmaMode = I2C_DMA_TX_ACK;
+
+            if(!i2cNext)
+            {
+                UCB0IFG &= ~UCSTPIFG;
+                UCB0IE  |=  UCSTPIE;
+            }
+            else
+                UCB0IE  |=  i2cNext->read ? UCRXIE : UCTXIE;
+
+            break;
+        }
+
+        // the repeated START of the next job is out, so the last byte of i2cCur was acknowledged
+        if(i2cDmaMode == I2C_DMA_TX_ACK)
+        {
+            UCB0IE &= ~UCTXIE;
+            i2cAdvance(I2C_OK);
+
+            __bic_SR_register_on_exit(LPM0_bits);
+            break;
+        }
+
         UCB0TXBUF = i2cTxBuffer[txBufIdx++];
 
         // once the interrupt is less than zero, stop transmitting data and release the i2c bus
@@ -190,6 +771,8 @@ __interrupt void ucsiB0Isr()
             nackEvent = 0;
             txBufIdx = 0;
             rxBufIdx = 0;
+
+            i2cKick(0);
         }
 
         break;
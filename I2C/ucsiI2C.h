@@ -9,7 +9,108 @@
 
 #define I2C_SDA         BIT0
 #define I2C_SCL         BIT1
-#define I2C_MAX_BUF     50
+#define I2C_MAX_BUF     50          // size of the buffers of ucsiB0I2CTxChar and ucsiB0I2CRxCharNoPoll
+
+
+// status of a transaction
+#define I2C_PENDING     1           // the transaction is still running
+#define I2C_OK          0
+#define I2C_ERR_BUSY    -1          // the bus or the driver was already in use
+#define I2C_ERR_NACK    -2          // the slave didn't acknowledge
+
+
+/* DMA mode
+
+ * DMA2 moves the bytes straight between UCB0TXBUF/UCB0RXBUF and the buffer of the caller, so
+   there is no copy and no interrupt per byte. The buffer must stay valid until the transaction
+   is done. DMA0 and DMA1 are left to the USCI_A0 backend of the DS18B20 driver
+ * A transmit takes the DMA interrupt and one UCTXIFG to send the STOP once the last byte left
+   UCB0TXBUF, then UCSTPIFG ends it once the last byte was acknowledged. A receive takes two DMA
+   interrupts since the STOP has to be set while the last byte is being received
+ * a single byte read has no interrupt between its address and its byte, so UCTXSTT is polled
+   for at most I2C_STT_WAIT reads to set the STOP while the byte is received. Any more would
+   clock a register out of the slave, which loses the data of a FIFO or clear-on-read register  */
+#ifndef I2C_STT_WAIT
+#define I2C_STT_WAIT    2000        // UCTXSTT reads, covers a byte, a repeated START and an address at 100 kHz up to 25 MHz
+#endif
+
+#define I2C_DMA_TX_TRIG 19          // DMA trigger of UCB0TXIFG
+#define I2C_DMA_RX_TRIG 18          // DMA trigger of UCB0RXIFG
+
+/* DMA_VECTOR of this driver also calls tsUartDmaIsr when the USCI_A0 backend of the DS18B20
+   driver is linked in, that backend leaves DMA_VECTOR to this driver by default                 */
+#ifndef I2C_DMA_ISR
+#define I2C_DMA_ISR     1           // set to 0 if another driver owns DMA_VECTOR, then call i2cDmaIsr from it
+#endif
+
+
+/* segment of a scatter-gather transaction
+
+ * the segments of a transaction are sent or received back to back between a single START and
+   STOP, so a transaction can be as long as needed without any buffer in the driver (e.g. the
+   address of an EEPROM page followed by the 256 bytes of the page)                              */
+typedef struct I2CSegment
+{
+    char*           data;
+    unsigned int    len;
+} I2CSegment;
+
+
+/* job queue
+
+ * a job is a whole transaction with its own segments, address and completion callback. Jobs are
+   queued by i2cSubmit and run in order by the ISR, which sets the repeated START of the next job
+   while the last byte of the current one is on the bus, so queued jobs go out without a STOP or
+   an idle bus between them and without the main loop getting involved
+ * the callback is called from the ISR once the job is done, the next job is already running by
+   then. It can submit another job
+ * a write job is only done once its last byte was acknowledged, which the STOP or the START of
+   the next job shows, so a NACK of that byte is never charged to the next job
+ * a single byte read can't be followed by a repeated START, it always ends with a STOP. A job
+   started while a STOP is still going out waits for UCSTPIFG
+ * the ring only holds I2C_QUEUE_LEN - 1 jobs, and i2cSubmit masks the interrupts for the few
+   instructions it takes to add one. The ISR only polls the USCI for the address of a single
+   byte read, for at most I2C_STT_WAIT reads                                                     */
+#ifndef I2C_QUEUE_LEN
+#define I2C_QUEUE_LEN   8           // must be a power of 2
+#endif
+
+#if I2C_QUEUE_LEN < 2 || I2C_QUEUE_LEN > 256 || (I2C_QUEUE_LEN & (I2C_QUEUE_LEN - 1))
+#error "I2C_QUEUE_LEN must be a power of 2 between 2 and 256"
+#endif
+
+typedef struct I2CJob I2CJob;
+typedef void (*I2CCallback)(I2CJob* job);
+
+struct I2CJob
+{
+    const I2CSegment*   segs;
+    int                 nSegs;
+    const I2CSegment*   rxSegs;     // read phase of a write job after a repeated START, or 0
+    int                 nRxSegs;
+    int                 addr;
+    char                read;       // 1 to fill the segments, 0 to send them
+    I2CCallback         done;       // called from the ISR once the job is done, or 0
+    volatile int        status;     // I2C_PENDING until the job is done, then I2C_OK or I2C_ERR_NACK
+};
+
+
+/* register access
+
+ * the register address is written and the register is read back in the same job, with a repeated
+   START in between instead of a STOP, so no other master can move the register pointer between
+   the two. Reading more than one byte is a burst read of the registers that follow
+ * a 16 bit register address is sent most significant byte first                                */
+#define I2C_REG_8       1
+#define I2C_REG_16      2
+
+typedef struct I2CRegJob
+{
+    I2CJob      job;                // first, so the callback can cast its job back
+    I2CSegment  tx;
+    I2CSegment  rx;
+    char        regAddr[2];
+} I2CRegJob;
 
 /******************************************************************************************
  * Function:    ucsiB0I2CInit
@@ -29,7 +130,7 @@ void ucsiB0I2CInit(char addrSize, int i2cClk);
  * Description: - Transmit an array of bytes through I2C to an given slave
  *
  * Input:       - data:     The array of bytes to be transmitted
- *              - bufLen:   Size of the array
+ *              - bufLen:   Size of the array, less than I2C_MAX_BUF
  *              - addr:     The address of the slave
  * Outputs:     - None
  *
@@ -41,13 +142,17 @@ int ucsiB0I2CTxChar(char* data, int bufLen, int addr);
  * Function:    ucsiB0I2CRxChar
  *
  * Description: - Receive an array of bytes through I2C by an given slave
+ *              - The DMA receives the bytes while the CPU sleeps in LPM0, it is only woken
+ *              up once the whole array is received or the slave didn't acknowledge. The
+ *              caller gets its own GIE back when it returns, it must not be called from an ISR
  *
- * Input:       - data:     The array of bytes to be received
- *              - bufLen:   Size of the array
+ * Input:       - bufLen:   Size of the array, at least 1
  *              - addr:     The address of the slave
- * Outputs:     - None
+ * Outputs:     - data:     The array of bytes received, the first I2C_MAX_BUF bytes are
+ *                          also copied in the buffer of i2cGetRxAddr
  *
- * Returns: 0 if the bus is released, otherwise returns -1
+ * Returns: I2C_OK once the array is received, I2C_ERR_BUSY if the bus or the driver was
+ *          already in use, and I2C_ERR_NACK if the slave didn't acknowledge
  ******************************************************************************************/
 int ucsiB0I2CRxChar(char* data, int bufLen, int addr);
 
@@ -56,9 +161,11 @@ int ucsiB0I2CRxChar(char* data, int bufLen, int addr);
  *
  * Description: - Receive an array of bytes through I2C by an given slave without polling
  *              the receiving data. The receiving data is handled by the ISR.
+ *              - i2cRxStatus tells when the data is ready, the CPU is also woken up from
+ *              LPM0 then
  *
  * Input:       - data:     The address of the array of bytes to be received
- *              - bufLen:   Size of the array
+ *              - bufLen:   Size of the array, less than I2C_MAX_BUF
  *              - addr:     The address of the slave
  * Outputs:     - None
  *
@@ -78,6 +185,185 @@ int ucsiB0I2CRxCharNoPoll(char** data, int bufLen, int addr);
  ******************************************************************************************/
 volatile char* i2cGetRxAddr();
 
+/******************************************************************************************
+ * Function:    i2cRxStatus
+ *
+ * Description: - Get the status of the last ucsiB0I2CRxCharNoPoll
+ *
+ * Input:       - None
+ * Outputs:     - None
+ *
+ * Returns: I2C_PENDING while it is running, I2C_OK once the data is in the buffer, and
+ *          I2C_ERR_NACK if the slave didn't acknowledge
+ ******************************************************************************************/
+int i2cRxStatus();
+
+/******************************************************************************************
+ * Function:    ucsiB0I2CTxDma
+ *
+ * Description: - Transmit an array of bytes through I2C to an given slave with the DMA,
+ *              straight from the array of the caller
+ *              - The function returns right away, the array must not change until
+ *              i2cDmaStatus returns something else than I2C_PENDING
+ *
+ * Input:       - data:     The array of bytes to be transmitted
+ *              - bufLen:   Size of the array, at least 1
+ *              - addr:     The address of the slave
+ * Outputs:     - None
+ *
+ * Returns: 0 if the transaction was started, otherwise returns -1
+ ******************************************************************************************/
+int ucsiB0I2CTxDma(const char* data, int bufLen, int addr);
+
+/******************************************************************************************
+ * Function:    ucsiB0I2CRxDma
+ *
+ * Description: - Receive an array of bytes through I2C by an given slave with the DMA,
+ *              straight into the array of the caller
+ *              - The function returns right away, except for a single byte which waits
+ *              for the address to be sent so the STOP can follow it
+ *
+ * Input:       - bufLen:   Size of the array, at least 1
+ *              - addr:     The address of the slave
+ * Outputs:     - data:     The array of bytes received
+ *
+ * Returns: 0 if the transaction was started, otherwise returns -1
+ ******************************************************************************************/
+int ucsiB0I2CRxDma(char* data, int bufLen, int addr);
+
+/******************************************************************************************
+ * Function:    ucsiB0I2CTxSeg
+ *
+ * Description: - Transmit a list of segments through I2C to an given slave in a single
+ *              transaction, the DMA moves each segment straight from its array
+ *              - The function returns right away, the segments and their arrays must not
+ *              change until i2cDmaStatus returns something else than I2C_PENDING
+ *              - It doesn't queue, it fails while a job is running or queued
+ *
+ * Input:       - segs:     The segments to be transmitted, empty ones are skipped
+ *              - nSegs:    Amount of segments
+ *              - addr:     The address of the slave
+ * Outputs:     - None
+ *
+ * Returns: 0 if the transaction was started, otherwise returns -1
+ ******************************************************************************************/
+int ucsiB0I2CTxSeg(const I2CSegment* segs, int nSegs, int addr);
+
+/******************************************************************************************
+ * Function:    ucsiB0I2CRxSeg
+ *
+ * Description: - Receive a list of segments through I2C by an given slave in a single
+ *              transaction, the DMA fills each segment straight into its array
+ *              - The function returns right away the same way as ucsiB0I2CRxDma
+ *
+ * Input:       - segs:     The segments to be filled, empty ones are skipped
+ *              - nSegs:    Amount of segments
+ *              - addr:     The address of the slave
+ * Outputs:     - None
+ *
+ * Returns: 0 if the transaction was started, otherwise returns -1
+ ******************************************************************************************/
+int ucsiB0I2CRxSeg(const I2CSegment* segs, int nSegs, int addr);
+
+/******************************************************************************************
+ * Function:    i2cSubmit
+ *
+ * Description: - Add a job to the queue, it is started right away if the driver is idle,
+ *              otherwise the ISR starts it once the jobs before it are done
+ *              - The job, its segments and their arrays must not change until its status
+ *              is something else than I2C_PENDING
+ *
+ * Input:       - job:      The job to be run, with at least one byte
+ * Outputs:     - None
+ *
+ * Returns: 0 if the job was queued, -1 if it is empty or the queue is full
+ ******************************************************************************************/
+int i2cSubmit(I2CJob* job);
+
+/******************************************************************************************
+ * Function:    ucsiB0I2CWriteRead
+ *
+ * Description: - Transmit an array of bytes to an given slave, then receive an array from
+ *              it after a repeated START, both with the DMA in a single transaction
+ *              - The function returns right away the same way as ucsiB0I2CTxDma, both
+ *              arrays must not change until i2cDmaStatus returns something else than
+ *              I2C_PENDING
+ *
+ * Input:       - txData:   The array of bytes to be transmitted
+ *              - txLen:    Size of txData, at least 1
+ *              - rxLen:    Size of rxData, at least 1
+ *              - addr:     The address of the slave
+ * Outputs:     - rxData:   The array of bytes received
+ *
+ * Returns: 0 if the transaction was started, otherwise returns -1
+ ******************************************************************************************/
+int ucsiB0I2CWriteRead(const char* txData, int txLen, char* rxData, int rxLen, int addr);
+
+/******************************************************************************************
+ * Function:    i2cRegRead
+ *
+ * Description: - Queue the read of one or more registers of an given slave, the register
+ *              address and the read go out as a single transaction
+ *              - reg and data must stay valid until reg->job.status is something else
+ *              than I2C_PENDING
+ *
+ * Input:       - reg:      The job to be used, owned by the caller
+ *              - addr:     The address of the slave
+ *              - regAddr:  The address of the first register
+ *              - regSize:  I2C_REG_8 or I2C_REG_16
+ *              - len:      Amount of bytes to be read, at least 1. A single register is read
+ *                          without clocking the one after it out of the slave
+ *              - done:     Called from the ISR once the read is done, or 0
+ * Outputs:     - data:     The registers read
+ *
+ * Returns: 0 if the read was queued, otherwise returns -1
+ ******************************************************************************************/
+int i2cRegRead(I2CRegJob* reg, int addr, unsigned int regAddr, char regSize, char* data, unsigned int len, I2CCallback done);
+
+/******************************************************************************************
+ * Function:    i2cDmaStatus
+ *
+ * Description: - Get the status of the last DMA transaction, the CPU is also woken up from
+ *              LPM0 once it is done
+ *
+ * Input:       - None
+ * Outputs:     - None
+ *
+ * Returns: I2C_PENDING while it is running, I2C_OK once it is done, and I2C_ERR_NACK if
+ *          the slave didn't acknowledge
+ ******************************************************************************************/
+int i2cDmaStatus();
+
+/******************************************************************************************
+ * Function:    i2cDmaWait
+ *
+ * Description: - Sleep in LPM0 until the last DMA transaction is done, the interrupts are
+ *              only enabled while it sleeps and the GIE of the caller is restored
+ *              - It must not be called from an ISR, nor while I2C_DMA_ISR is 0 unless the
+ *              DMA_VECTOR ISR of the application calls i2cDmaIsr and leaves LPM0 when it
+ *              returns 1, otherwise it never wakes up
+ *
+ * Input:       - None
+ * Outputs:     - None
+ *
+ * Returns: The same as i2cDmaStatus, except I2C_PENDING
+ ******************************************************************************************/
+int i2cDmaWait();
+
+/******************************************************************************************
+ * Function:    i2cDmaIsr
+ *
+ * Description: - Handles the DMA2 interrupt of the DMA mode
+ *              - It is only needed if I2C_DMA_ISR is 0, in which case it must be called by
+ *              the DMA_VECTOR ISR of the application
+ *
+ * Input:       - None
+ * Outputs:     - None
+ *
+ * Returns: 1 if a transaction is done and the CPU must leave LPM0, otherwise returns 0
+ ******************************************************************************************/
+int i2cDmaIsr();
+
 
 
 